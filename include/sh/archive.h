@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <sh/error.h>
+#include <sh/filesystem.h>
+#include <sh/int.h>
+#include <sh/vector.h>
+
+namespace sh::archive {
+
+// Specialize to serialize types which are not trivially copyable:
+//
+// template<>
+// struct sh::archive::serializer<person> {
+//   static void write(sh::archive::writer& dst, const person& value) {
+//     dst.write(value.name);
+//     dst.write(value.age);
+//   }
+//
+//   static auto read(sh::archive::reader& src) -> person {
+//     return {src.read<std::string>(), src.read<int>()};
+//   }
+// };
+template<typename T>
+struct serializer {
+  ~serializer() = delete;
+};
+
+template<typename T>
+concept serializable = std::destructible<serializer<T>>;
+
+namespace {
+
+constexpr u32 kMagic = 0x5241'4853;
+constexpr u16 kVersion = 1;
+constexpr u16 kEndian = 0x0102;
+
+struct header {
+  u32 magic;
+  u16 version;
+  u16 endian;
+};
+
+template<typename T>
+inline constexpr bool is_span_v = false;
+
+template<typename T, std::size_t kExtent>
+inline constexpr bool is_span_v<std::span<T, kExtent>> = true;
+
+template<typename T>
+concept trivial_range = std::ranges::contiguous_range<T>
+  && std::is_trivially_copyable_v<std::ranges::range_value_t<T>>;
+
+template<typename T>
+concept trivial_container = trivial_range<T>
+  && std::constructible_from<T, const std::ranges::range_value_t<T>*, const std::ranges::range_value_t<T>*>;
+
+}  // namespace
+
+// Writes values into a byte buffer. Trivially copyable values are stored
+// aligned to their alignment, ranges are stored as a count followed by their
+// elements and trivially copyable ranges as one block. The offset before a
+// write addresses the written value, storing offsets lets readers jump to
+// values directly instead of reading everything in order.
+class writer {
+public:
+  writer() {
+    const header header{kMagic, kVersion, kEndian};
+    append(&header, sizeof(header), alignof(struct header));
+  }
+
+  template<typename T>
+  void write(const T& value) {
+    if constexpr (serializable<T>) {
+      serializer<T>::write(*this, value);
+    } else if constexpr (std::convertible_to<const T&, std::string_view>) {
+      const auto view = std::string_view(value);
+      write<u64>(view.size());
+      append(view.data(), view.size(), 1);
+    } else if constexpr (trivial_range<T>) {
+      using value_type = std::ranges::range_value_t<T>;
+      write<u64>(std::ranges::size(value));
+      append(std::ranges::data(value), std::ranges::size(value) * sizeof(value_type), alignof(value_type));
+    } else if constexpr (std::ranges::sized_range<T>) {
+      write<u64>(std::ranges::size(value));
+      for (const auto& element : value) {
+        write(element);
+      }
+    } else {
+      static_assert(std::is_trivially_copyable_v<T>, "type is not serializable");
+      append(&value, sizeof(T), alignof(T));
+    }
+  }
+
+  [[nodiscard]] auto data() const -> std::span<const u8> {
+    return {data_.data(), data_.size()};
+  }
+
+  [[nodiscard]] auto offset() const -> u64 {
+    return data_.size();
+  }
+
+  auto save(const filesystem::path& file) const -> filesystem::status {
+    filesystem::writer writer;
+    if (const auto result = writer.open(file, filesystem::writer::durability::atomic, data_.size()); result != filesystem::status::ok) {
+      return result;
+    }
+    if (const auto result = writer.write(data_); result != filesystem::status::ok) {
+      return result;
+    }
+    return writer.close();
+  }
+
+private:
+  void append(const void* data, std::size_t size, std::size_t alignment) {
+    const auto offset = (data_.size() + alignment - 1) & ~(alignment - 1);
+    if (offset + size > data_.capacity()) {
+      data_.reserve(std::max(offset + size, 2 * data_.capacity()));
+    }
+    data_.resize(offset);
+    data_.resize_for_overwrite(offset + size);
+    if (size) {
+      std::memcpy(data_.data() + offset, data, size);
+    }
+  }
+
+  vector<u8> data_;
+};
+
+// Reads values in the order they were written, or at offsets recorded by
+// the writer. Strings and trivially copyable ranges can be viewed in place
+// without copying. Every access is bounds checked and throws on malformed
+// data.
+class reader {
+public:
+  reader() = default;
+
+  auto open(std::span<const u8> data) -> filesystem::status {
+    file_.close();
+    return attach(data);
+  }
+
+  // Keeps the previous data if the file cannot be opened.
+  auto open(const filesystem::path& file) -> filesystem::status {
+    filesystem::mapped_file mapping;
+    if (const auto result = mapping.open(file); result != filesystem::status::ok) {
+      return result;
+    }
+    file_ = std::move(mapping);
+    return attach(file_.bytes());
+  }
+
+  template<typename T>
+  auto read() -> T {
+    if constexpr (serializable<T>) {
+      return serializer<T>::read(*this);
+    } else if constexpr (std::same_as<T, std::string_view>) {
+      return view_string();
+    } else if constexpr (std::same_as<T, std::string>) {
+      return std::string(view_string());
+    } else if constexpr (is_span_v<T>) {
+      return view<std::remove_const_t<typename T::element_type>>();
+    } else if constexpr (trivial_range<T> && std::is_trivially_copyable_v<T>) {
+      const auto span = view<std::ranges::range_value_t<T>>();
+      T values;
+      if (span.size() != std::ranges::size(values)) {
+        throw error("archive range size mismatch: {}", span.size());
+      }
+      std::copy(span.begin(), span.end(), std::ranges::begin(values));
+      return values;
+    } else if constexpr (trivial_container<T>) {
+      const auto span = view<std::ranges::range_value_t<T>>();
+      return T(span.data(), span.data() + span.size());
+    } else if constexpr (std::ranges::sized_range<T>) {
+      T values;
+      const auto size = read<u64>();
+      for (u64 i = 0; i < size; ++i) {
+        values.push_back(read<std::ranges::range_value_t<T>>());
+      }
+      return values;
+    } else {
+      static_assert(std::is_trivially_copyable_v<T>, "type is not serializable");
+      T value;
+      std::memcpy(&value, take(sizeof(T), alignof(T)), sizeof(T));
+      return value;
+    }
+  }
+
+  // Views a trivially copyable range in place. The view is valid as long as
+  // the underlying data.
+  template<typename T>
+    requires std::is_trivially_copyable_v<T>
+  auto view() -> std::span<const T> {
+    const auto size = read<u64>();
+    if (size > data_.size() / sizeof(T)) {
+      throw error("archive range out of bounds: {}", size);
+    }
+    const auto data = take(size * sizeof(T), alignof(T));
+    if (reinterpret_cast<std::uintptr_t>(data) % alignof(T)) {
+      throw error("archive data is misaligned");
+    }
+    return {reinterpret_cast<const T*>(data), size};
+  }
+
+  auto view_string() -> std::string_view {
+    const auto size = read<u64>();
+    return {reinterpret_cast<const char*>(take(size, 1)), size};
+  }
+
+  // Continues reading at an offset returned by writer::offset.
+  void seek(u64 offset) {
+    if (offset < sizeof(header) || offset > data_.size()) {
+      throw error("archive offset out of bounds: {}", offset);
+    }
+    offset_ = offset;
+  }
+
+  [[nodiscard]] auto offset() const -> u64 {
+    return offset_;
+  }
+
+  [[nodiscard]] auto remaining() const -> std::size_t {
+    return data_.size() - offset_;
+  }
+
+private:
+  auto attach(std::span<const u8> data) -> filesystem::status {
+    data_ = data;
+    offset_ = 0;
+
+    header header;
+    if (data.size() < sizeof(header)) {
+      data_ = {};
+      return filesystem::status::bad_size;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != kMagic || header.version != kVersion || header.endian != kEndian) {
+      data_ = {};
+      return filesystem::status::bad_size;
+    }
+    offset_ = sizeof(header);
+    return filesystem::status::ok;
+  }
+
+  auto take(std::size_t size, std::size_t alignment) -> const u8* {
+    const auto offset = (offset_ + alignment - 1) & ~(alignment - 1);
+    if (offset > data_.size() || size > data_.size() - offset) {
+      throw error("archive read out of bounds: {} + {}", offset, size);
+    }
+    offset_ = offset + size;
+    return data_.data() + offset;
+  }
+
+  filesystem::mapped_file file_;
+  std::span<const u8> data_;
+  std::size_t offset_ = 0;
+};
+
+}  // namespace sh::archive
@@ -1,46 +1,122 @@
 #pragma once
 
+#include <deque>
+#include <functional>
 #include <memory>
+#include <span>
+#include <unordered_map>
 #include <vector>
 #include <sh/concepts.h>
+#include <sh/config.h>
+#include <sh/enum.h>
 #include <sh/error.h>
 #include <sh/filesystem.h>
+#include <sh/hash.h>
 #include <sh/parse.h>
 #include <sh/ranges.h>
 
 namespace sh {
 
+// Counts the occurrences of a flag, -vvv counts three times.
+class counter {
+public:
+  constexpr counter(std::size_t value = 0)
+    : value_(value) {}
+
+  constexpr operator std::size_t() const {
+    return value_;
+  }
+
+private:
+  std::size_t value_;
+};
+
+template<>
+struct parser<counter> {
+  auto parse(std::string_view data) -> std::optional<counter> {
+    return sh::parse<std::size_t>(data);
+  }
+};
+
 namespace {
 
-template<formattable T>
-auto repr(const T& value) -> std::string {
+template<std::size_t kSize>
+auto view(const vector<char, kSize>& buffer) -> std::string_view {
+  return {buffer.data(), buffer.size()};
+}
+
+template<std::size_t kSize, formattable T>
+void repr(vector<char, kSize>& dst, const T& value) {
   if constexpr (std::convertible_to<T, std::string_view>) {
-    return fmt::format(R"("{}")", std::string_view{value});
+    format_to(dst, R"("{}")", std::string_view{value});
   } else if constexpr (std::same_as<T, std::filesystem::path>) {
-    return fmt::format(R"("{}")", value);
+    format_to(dst, R"("{}")", value);
   } else {
-    return fmt::to_string(value);
+    format_to(dst, "{}", value);
   }
 }
 
-inline auto split(std::string_view view, char delimiter) -> std::vector<std::string_view> {
+struct key_value {
+  std::string_view key;
+  std::optional<std::string_view> value;
+};
+
+inline auto split(std::string_view view, char delimiter) -> key_value {
   const auto pos = view.find_first_of(delimiter);
   if (pos == std::string_view::npos) {
-    return {view};
+    return {view, std::nullopt};
   } else {
     return {view.substr(0, pos), view.substr(pos + 1)};
   }
 }
 
-inline auto trim(std::string_view view) -> std::string_view {
-  const auto pos = view.find_first_not_of(' ');
-  if (std::string_view::npos == pos) {
-    return view;
+// Splits response file contents into arguments. Arguments are separated by
+// whitespace, quotes group whitespace and backslashes escape the following
+// character. Quotes and escapes are removed in place, which keeps every
+// argument a contiguous view into the buffer.
+template<typename Callback>
+void tokenize(char* data, std::size_t size, Callback&& callback) {
+  auto read = data;
+  const auto last = data + size;
+  const auto space = [](char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  };
+
+  while (true) {
+    while (read != last && space(*read)) {
+      read++;
+    }
+    if (read == last) {
+      break;
+    }
+
+    const auto first = read;
+    auto write = read;
+    char quote = 0;
+    while (read != last && (quote || !space(*read))) {
+      const auto c = *read++;
+      if (quote) {
+        if (c == quote) {
+          quote = 0;
+        } else if (c == '\\' && quote == '"' && read != last && (*read == '"' || *read == '\\')) {
+          *write++ = *read++;
+        } else {
+          *write++ = c;
+        }
+      } else if (c == '"' || c == '\'') {
+        quote = c;
+      } else if (c == '\\' && read != last) {
+        *write++ = *read++;
+      } else {
+        *write++ = c;
+      }
+    }
+    callback(std::string_view(first, write - first));
   }
-  const auto end = view.find_last_not_of(' ');
-  return view.substr(pos, end - pos + 1);
 }
 
+using detail::trim;
+
 template<typename T>
 struct value_type {
   using type = T;
@@ -51,9 +127,20 @@ struct value_type<std::optional<T>> {
   using type = T;
 };
 
+template<typename T, std::size_t kSize>
+struct value_type<vector<T, kSize>> {
+  using type = T;
+};
+
 template<typename T>
 using value_type_t = typename value_type<T>::type;
 
+template<typename T>
+inline constexpr bool is_accumulating_v = false;
+
+template<typename T, std::size_t kSize>
+inline constexpr bool is_accumulating_v<vector<T, kSize>> = true;
+
 template<typename T>
 concept argument_type = parsable<value_type_t<T>> && formattable<value_type_t<T>>;
 
@@ -66,61 +153,92 @@ class basic_argument {
   friend class clap;
 
   explicit basic_argument(const std::vector<std::string_view>& names)
-    : names_(names) {}
+    : names_(names) {
+    for (const auto& name : names_) {
+      if (name.starts_with('-')) {
+        positional_ = false;
+      }
+    }
+  }
 
 protected:
   virtual auto boolean() const -> bool = 0;
   virtual auto optional() const -> bool = 0;
+  virtual auto counting() const -> bool = 0;
   virtual void validate() const = 0;
+  virtual void resolve() const = 0;
+  virtual auto parsed() const -> bool = 0;
   virtual void parse(std::optional<std::string_view>) = 0;
+  virtual void reserve(std::size_t count) = 0;
 
   std::vector<std::string_view> names_;
   std::string_view what_ = "value";
   std::string_view desc_;
-  std::string default_repr_;
+  vector<char, 32> default_repr_;
 
 private:
   auto positional() const -> bool {
+    return positional_;
+  }
+
+  bool positional_ = true;
+
+  auto names_size() const -> std::size_t {
+    std::size_t size = 2 * (names_.size() - 1);
     for (const auto& name : names_) {
-      if (name.starts_with('-')) {
-        return false;
-      }
+      size += name.size();
     }
-    return true;
+    return size;
   }
 
-  auto names() const -> std::string {
-    return fmt::to_string(fmt::join(names_, ", "));
+  template<std::size_t kSize>
+  void names(vector<char, kSize>& dst) const {
+    format_to(dst, "{}", fmt::join(names_, ", "));
   }
 
-  auto usage() const -> std::string {
-    std::string usage(names_.front());
+  template<std::size_t kSize>
+  void usage(vector<char, kSize>& dst) const {
+    const auto optional = this->optional();
+    if (optional) {
+      dst.push_back('[');
+    }
     if (positional()) {
-      usage = fmt::format("<{}>", usage);
+      format_to(dst, "<{}>", names_.front());
     } else if (!boolean()) {
-      usage = fmt::format("{} <{}>", usage, what_);
+      format_to(dst, "{} <{}>", names_.front(), what_);
+    } else {
+      format_to(dst, "{}", names_.front());
     }
-    if (optional()) {
-      usage = fmt::format("[{}]", usage);
+    if (optional) {
+      dst.push_back(']');
     }
-    return usage;
   }
 
-  auto description() const -> std::string {
-    std::vector<std::string> desc;
+  template<std::size_t kSize>
+  void description(vector<char, kSize>& dst) const {
     if (!desc_.empty()) {
-      desc.emplace_back(desc_);
+      format_to(dst, "{}", desc_);
     }
     if (!default_repr_.empty()) {
-      desc.emplace_back(fmt::format("[default: {}]", default_repr_));
+      if (!desc_.empty()) {
+        dst.push_back(' ');
+      }
+      format_to(dst, "[default: {}]", view(default_repr_));
     }
-    return fmt::to_string(fmt::join(desc, " "));
   }
 };
 
 class what : public std::string_view {};
 class desc : public std::string_view {};
 
+// Defers conversion until the value is first requested. Arguments with a
+// pointer or events are always converted while parsing.
+struct lazy_t {};
+inline constexpr lazy_t lazy;
+
+// Arguments of type sh::vector<T> collect every occurrence, events receive
+// the elements one at a time. Arguments of type sh::counter count them.
+// Both are optional and default to empty.
 template<argument_type T>
 class argument final : public basic_argument {
 public:
@@ -131,12 +249,9 @@ class argument final : public basic_argument {
 
   explicit argument(const std::vector<std::string_view>& names)
     : basic_argument(names) {
-    *this << [this](const value_type& value) {
-      if (pointer_) *pointer_ = value;
-    };
-    *this << [this](const value_type& value) {
-      value_ = value;
-    };
+    if constexpr (named_enum<value_type>) {
+      what_ = enum_choices<value_type>();
+    }
   }
 
   auto operator<<(T* pointer) -> argument& {
@@ -157,7 +272,8 @@ class argument final : public basic_argument {
 
   auto operator<<(const value_type& value) -> argument& {
     default_ = T{value};
-    default_repr_ = repr(value);
+    default_repr_.clear();
+    repr(default_repr_, value);
     sync();
     return *this;
   }
@@ -167,66 +283,132 @@ class argument final : public basic_argument {
     return *this;
   }
 
+  auto operator<<(lazy_t) -> argument& {
+    lazy_ = true;
+    return *this;
+  }
+
 protected:
   auto boolean() const -> bool final {
-    return std::same_as<value_type, bool>;
+    return std::same_as<value_type, bool> || std::same_as<T, counter>;
   }
 
   auto optional() const -> bool final {
-    return specialization<T, std::optional> || default_;
+    return specialization<T, std::optional> || std::same_as<T, counter> || is_accumulating_v<T> || default_;
+  }
+
+  auto counting() const -> bool final {
+    return std::same_as<T, counter>;
   }
 
   void validate() const final {
-    if (!(optional() || value_)) {
+    if (!(optional() || value_ || raw_)) {
       throw error("missing required argument: {}", names_.front());
     }
   }
 
-  void parse(std::optional<std::string_view> data) final {
-    auto broadcast = [this](const value_type& value) {
-      for (const auto& event : events_) {
-        event(value);
+  void resolve() const final {
+    if constexpr (!is_accumulating_v<T>) {
+      if (raw_) {
+        value_ = convert(*raw_);
+        raw_.reset();
       }
-    };
+    }
+  }
 
+  auto parsed() const -> bool final {
+    return value_ || raw_;
+  }
+
+  void parse(std::optional<std::string_view> data) final {
     if (data) {
-      const auto& view = trim(*data);
-      if (const auto value = sh::parse<value_type>(view)) {
-        broadcast(*value);
+      if (lazy_ && !pointer_ && events_.empty() && !is_accumulating_v<T>) {
+        raw_ = data;
+        value_.reset();
       } else {
-        throw error("invalid argument data: {}", view);
+        broadcast(convert(*data));
       }
     } else {
       if constexpr (std::same_as<value_type, bool>) {
         broadcast(true);
+      } else if constexpr (std::same_as<T, counter>) {
+        broadcast(value_ ? *value_ + 1 : 1);
       } else {
         throw error("missing argument data: {}", names_.front());
       }
     }
   }
 
+  // Accumulating arguments reserve space for count values once they are
+  // first given, no argument occurs more often than there are arguments.
+  void reserve(std::size_t count) final {
+    if constexpr (is_accumulating_v<T>) {
+      reserve_ = count;
+    }
+  }
+
 private:
+  auto convert(std::string_view data) const -> value_type {
+    const auto& view = trim(data);
+    if (auto value = sh::parse<value_type>(view)) {
+      return std::move(*value);
+    }
+    throw error("invalid argument data: {}", view);
+  }
+
   T value() const {
+    resolve();
     if (value_) {
       return *value_;
     } else if (default_) {
       return *default_;
     } else if constexpr (specialization<T, std::optional>) {
       return std::nullopt;
+    } else if constexpr (std::same_as<T, counter> || is_accumulating_v<T>) {
+      return T{};
     }
     throw error("empty argument: {}", names_.front());
   }
 
+  void broadcast(const value_type& value) {
+    if constexpr (is_accumulating_v<T>) {
+      if (!value_) {
+        value_.emplace();
+        value_->reserve(reserve_);
+        if (pointer_) {
+          pointer_->clear();
+          pointer_->reserve(reserve_);
+        }
+      }
+      value_->push_back(value);
+      if (pointer_) {
+        pointer_->push_back(value);
+      }
+    } else {
+      if (pointer_) {
+        *pointer_ = value;
+      }
+      raw_.reset();
+      value_ = value;
+    }
+    for (const auto& event : events_) {
+      event(value);
+    }
+  }
+
   void sync() {
     if (pointer_ && default_) {
       *pointer_ = *default_;
     }
   }
 
+  bool lazy_ = false;
+  std::size_t reserve_ = 0;
   T* pointer_ = nullptr;
-  std::optional<T> value_;
+  mutable std::optional<std::string_view> raw_;
+  mutable std::optional<T> value_;
   std::optional<T> default_;
-  std::vector<event> events_;
+  vector<event, 2> events_;
 };
 
 class clap {
@@ -238,11 +420,26 @@ class clap {
     requires not_empty<Names...>
   auto add(Names&&... names) -> argument<T>& {
     const auto views = {trim(names)...};
-    arguments_.emplace_back(std::make_unique<argument<T>>(views));
-    return *static_cast<argument<T>*>(arguments_.back().get());
+    auto& argument = *arguments_.emplace_back(std::make_unique<sh::argument<T>>(views));
+    for (const auto& name : argument.names_) {
+      index_.emplace(name, &argument);
+    }
+    if (argument.positional()) {
+      positionals_.push_back(&argument);
+    }
+    return static_cast<sh::argument<T>&>(argument);
+  }
+
+  // Registers a command whose arguments are added by the callback once the
+  // command is selected. Remaining arguments are parsed by the command.
+  void add_command(std::string_view name, std::function<void(clap&)> callback, desc desc = {}) {
+    name = trim(name);
+    command_index_.emplace(name, commands_.size());
+    commands_.push_back({name, desc, std::move(callback)});
   }
 
   void add_help() {
+    help_ = true;
     add<std::optional<bool>>("-h", "--help") << desc("print help") << [this](bool value) {
       if (value) {
         fmt::print("{}\n", help());
@@ -251,53 +448,55 @@ class clap {
     };
   }
 
-  void parse(int argc, const char* const* argv) {
-    auto index = 1;
-    auto pos_index = 0;
-    auto pos_force = false;
-    while (index < argc) {
-      const auto& data = trim(argv[index++]);
-      if (data == "--" && !pos_force) {
-        pos_force = true;
-        continue;
-      }
+  void add_response_files(std::size_t max_depth = 16) {
+    response_depth_ = max_depth;
+  }
 
-      const auto kvp = split(data, '=');
-      const auto argument = find(kvp.front());
-      if (argument && !argument->positional() && !pos_force) {
-        if (kvp.size() == 2) {
-          argument->parse(kvp.back());
-        } else if (index < argc && !argument->boolean()) {
-          argument->parse(argv[index++]);
-        } else {
-          argument->parse(std::nullopt);
-        }
-      } else {
-        if (const auto argument = find(pos_index++)) {
-          argument->parse(data);
-        } else {
-          unmatched.emplace_back(data);
-        }
-      }
-    }
+  void parse(int argc, const char* const* argv) {
+    parse(std::span<const char* const>(argv, argc), nullptr);
+  }
 
-    for (const auto& argument : arguments_) {
-      argument->validate();
-    }
+  // Keyword arguments missing on the command line are read from the config.
+  // Keys are argument names without leading dashes. The program reads keys
+  // before the first section, commands read the section of their name.
+  // Values taken from the config are copied, the config does not have to
+  // outlive the parser.
+  void parse(int argc, const char* const* argv, const config& config) {
+    parse(std::span<const char* const>(argv, argc), &config);
   }
 
   void try_parse(int argc, const char* const* argv) {
     try {
       parse(argc, argv);
     } catch (const error& error) {
-      fmt::print("{}\n\n{}\n", error, help());
+      auto failed = this;
+      while (failed->command_failed_) {
+        failed = failed->command_.get();
+      }
+      fmt::print("{}\n\n{}\n", error, failed->help());
       std::exit(1);
     }
   }
 
+  // Converts the values of lazy arguments. Call after parsing to report
+  // invalid data before the program starts working with it.
+  void resolve() const {
+    for (const auto& argument : arguments_) {
+      argument->resolve();
+    }
+  }
+
+  [[nodiscard]] auto command() const -> clap* {
+    return command_.get();
+  }
+
+  [[nodiscard]] auto command_name() const -> std::string_view {
+    return command_name_;
+  }
+
   template<argument_type T>
   auto get(std::string_view name) const -> T {
-    if (const auto argument = find(name)) {
+    if (const auto argument = find(trim(name))) {
       return static_cast<sh::argument<T>*>(argument)->value();
     }
     throw error("unknown argument:", name);
@@ -306,60 +505,244 @@ class clap {
   auto help() const -> std::string {
     std::size_t padding = 0;
     for (const auto& argument : arguments_) {
-      padding = std::max(padding, argument->names().size());
+      padding = std::max(padding, argument->names_size());
     }
-
-    std::vector<std::string> usage;
-    if (!program_.empty()) {
-      usage.emplace_back(program_);
+    for (const auto& command : commands_) {
+      padding = std::max(padding, command.name.size());
     }
 
+    vector<char, 1024> help;
+    format_to(help, "usage:\n  {}", program_);
+    auto separate = !program_.empty();
+
     struct group {
       std::string_view caption;
-      std::string content;
+      vector<char, 1024> content;
     };
 
     group groups[2] = {{"keyword arguments"}, {"positional arguments"}};
     for (const auto& argument : arguments_) {
-      auto& group = groups[argument->positional()];
-      group.content.append(fmt::format("\n  {:<{}}{}", argument->names(), padding + 4, argument->description()));
-      usage.emplace_back(argument->usage());
+      vector<char, 64> names;
+      argument->names(names);
+
+      auto& content = groups[argument->positional()].content;
+      format_to(content, "\n  {:<{}}", view(names), padding + 4);
+      argument->description(content);
+
+      if (separate) {
+        help.push_back(' ');
+      }
+      argument->usage(help);
+      separate = true;
+    }
+
+    if (!commands_.empty()) {
+      if (separate) {
+        help.push_back(' ');
+      }
+      format_to(help, "<command> ...");
     }
 
-    auto help = fmt::format("usage:\n  {}", fmt::join(usage, " "));
     for (const auto& [caption, content] : groups) {
       if (!content.empty()) {
-        help.append(fmt::format("\n\n{}:", caption));
-        help.append(content);
+        format_to(help, "\n\n{}:{}", caption, view(content));
+      }
+    }
+
+    if (!commands_.empty()) {
+      format_to(help, "\n\ncommands:");
+      for (const auto& command : commands_) {
+        format_to(help, "\n  {:<{}}{}", command.name, padding + 4, command.description);
       }
     }
-    return help;
+    return std::string(view(help));
   }
 
-  std::vector<std::string> unmatched;
+  // Arguments which matched nothing. Parsing does not allocate as long as
+  // there are at most eight of them, more spill to the heap.
+  vector<std::string_view, 8> unmatched;
 
 private:
-  auto find(std::string_view name) const -> basic_argument* {
-    name = trim(name);
+  void parse(std::span<const char* const> args, const config* config) {
+    // POSIX allows argc to be zero, which leaves no program name to skip.
+    if (response_depth_ && !args.empty()) {
+      for (const auto& data : args.subspan(1)) {
+        if (data[0] == '@') {
+          expanded_.clear();
+          expanded_.emplace_back(args.front());
+          for (const auto& arg : args.subspan(1)) {
+            expand(arg, 0);
+          }
+          parse(std::span<const std::string_view>(expanded_), config, {});
+          return;
+        }
+      }
+    }
+    parse(args, config, {});
+  }
+
+  template<typename Args>
+  void parse(const Args& args, const config* config, std::string_view section) {
     for (const auto& argument : arguments_) {
-      if (contains(argument->names_, name)) {
-        return argument.get();
+      argument->reserve(args.size());
+    }
+
+    std::size_t index = 1;
+    std::size_t pos_index = 0;
+    auto pos_force = false;
+    while (index < args.size()) {
+      const auto& data = trim(args[index++]);
+      if (data == "--" && !pos_force) {
+        pos_force = true;
+        continue;
+      }
+
+      const auto [key, value] = split(data, '=');
+      const auto argument = find(trim(key));
+      if (argument && !argument->positional() && !pos_force) {
+        if (value) {
+          argument->parse(value);
+        } else if (index < args.size() && !argument->boolean()) {
+          argument->parse(args[index++]);
+        } else {
+          argument->parse(std::nullopt);
+        }
+      } else if (!pos_force && count(data)) {
+        continue;
+      } else if (!pos_force && dispatch(data, args.subspan(index - 1), config)) {
+        break;
+      } else {
+        if (const auto argument = find(pos_index++)) {
+          argument->parse(data);
+        } else {
+          unmatched.emplace_back(data);
+        }
       }
     }
-    return nullptr;
+
+    if (config) {
+      configure(*config, section);
+    }
+    for (const auto& argument : arguments_) {
+      argument->validate();
+    }
   }
 
-  auto find(std::size_t position) const -> basic_argument* {
+  void configure(const config& config, std::string_view section) {
     for (const auto& argument : arguments_) {
-      if (argument->positional() && position-- == 0) {
-        return argument.get();
+      if (argument->positional() || argument->parsed()) {
+        continue;
+      }
+      for (const auto& name : argument->names_) {
+        const auto key = name.substr(std::min(name.find_first_not_of('-'), name.size()));
+        const auto entries = config.find(section, key);
+        if (!key.empty() && !entries.empty()) {
+          for (const auto& entry : entries) {
+            argument->parse(config_values_.emplace_back(entry.value));
+          }
+          break;
+        }
       }
     }
-    return nullptr;
   }
 
-  std::string_view program_;
+  auto count(std::string_view data) const -> bool {
+    if (data.size() < 3 || data[0] != '-' || data[1] == '-') {
+      return false;
+    }
+    if (data.find_first_not_of(data[1], 2) != std::string_view::npos) {
+      return false;
+    }
+
+    const auto argument = find(data.substr(0, 2));
+    if (!argument || !argument->counting()) {
+      return false;
+    }
+    for (std::size_t i = 1; i < data.size(); ++i) {
+      argument->parse(std::nullopt);
+    }
+    return true;
+  }
+
+  template<typename Args>
+  auto dispatch(std::string_view name, const Args& args, const config* config) -> bool {
+    const auto iter = command_index_.find(name);
+    if (iter == command_index_.end()) {
+      return false;
+    }
+
+    const auto& command = commands_[iter->second];
+    command_ = std::make_unique<clap>(program_.empty() ? std::string(command.name) : fmt::format("{} {}", program_, command.name));
+    command_name_ = command.name;
+    if (help_) {
+      command_->add_help();
+    }
+    try {
+      command.callback(*command_);
+      command_->parse(args, config, command.name);
+    } catch (const error&) {
+      command_failed_ = true;
+      throw;
+    }
+    return true;
+  }
+
+  void expand(std::string_view arg, std::size_t depth) {
+    if (arg.size() < 2 || arg.front() != '@') {
+      expanded_.push_back(arg);
+      return;
+    }
+    if (depth == response_depth_) {
+      throw error("response file nesting too deep: {}", arg);
+    }
+
+    const auto file = arg.substr(1);
+    auto& response = responses_.emplace_back();
+    if (response.open(filesystem::u8path(file), filesystem::mapped_file::access::copy_on_write) != filesystem::status::ok) {
+      throw error("bad response file: {}", file);
+    }
+    tokenize(response.data(), response.size(), [this, depth](std::string_view token) {
+      expand(token, depth + 1);
+    });
+  }
+
+  auto find(std::string_view name) const -> basic_argument* {
+    const auto iter = index_.find(name);
+    return iter != index_.end() ? iter->second : nullptr;
+  }
+
+  auto find(std::size_t position) const -> basic_argument* {
+    return position < positionals_.size() ? positionals_[position] : nullptr;
+  }
+
+  struct subcommand {
+    std::string_view name;
+    std::string_view description;
+    std::function<void(clap&)> callback;
+  };
+
+  std::string program_;
+  bool help_ = false;
   std::vector<std::unique_ptr<basic_argument>> arguments_;
+  std::vector<basic_argument*> positionals_;
+  std::unordered_map<std::string_view, basic_argument*, string_hash> index_;
+  std::size_t response_depth_ = 0;
+  std::vector<std::string_view> expanded_;
+  std::vector<filesystem::mapped_file> responses_;
+  std::deque<std::string> config_values_;
+  std::vector<subcommand> commands_;
+  std::unordered_map<std::string_view, std::size_t, string_hash> command_index_;
+  std::unique_ptr<clap> command_;
+  std::string_view command_name_;
+  bool command_failed_ = false;
 };
 
 }  // namespace sh
+
+template<>
+struct fmt::formatter<sh::counter> : fmt::formatter<std::size_t> {
+  template<typename FormatContext>
+  auto format(sh::counter value, FormatContext& ctx) {
+    return fmt::formatter<std::size_t>::format(value, ctx);
+  }
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include <sh/error.h>
+#include <sh/filesystem.h>
+#include <sh/lines.h>
+
+namespace sh {
+
+// Reads INI-style files:
+//
+// ; comment
+// key = value
+// [section]
+// key = "quoted value"
+//
+// Sections, keys and values are string_views into the mapped file, so the
+// config must outlive them. Entries are kept in one sorted vector, keys
+// which appear more than once keep every value in file order.
+class config {
+public:
+  struct entry {
+    std::string_view section;
+    std::string_view key;
+    std::string_view value;
+  };
+
+  config() = default;
+
+  // Keeps the previous entries if the file cannot be opened. Syntax errors
+  // throw and leave the config empty. The mapping is copy on write because
+  // sh::parse may temporarily modify the values it parses.
+  auto open(const filesystem::path& file) -> filesystem::status {
+    filesystem::mapped_file mapping;
+    if (const auto result = mapping.open(file, filesystem::mapped_file::access::copy_on_write); result != filesystem::status::ok) {
+      return result;
+    }
+    file_ = std::move(mapping);
+    tokenize(file_.view());
+    return filesystem::status::ok;
+  }
+
+  void parse(std::string_view data) {
+    file_.close();
+    tokenize(data);
+  }
+
+  // Returns all values of a key in file order. Keys before the first
+  // section belong to the empty section.
+  [[nodiscard]] auto find(std::string_view section, std::string_view key) const -> std::span<const entry> {
+    const auto [first, last] = std::equal_range(entries_.begin(), entries_.end(), entry{section, key, {}}, less);
+    return {first, last};
+  }
+
+  // Returns the last value of a key.
+  [[nodiscard]] auto get(std::string_view section, std::string_view key) const -> std::optional<std::string_view> {
+    const auto entries = find(section, key);
+    if (entries.empty()) {
+      return std::nullopt;
+    }
+    return entries.back().value;
+  }
+
+  [[nodiscard]] auto entries() const -> std::span<const entry> {
+    return entries_;
+  }
+
+  [[nodiscard]] auto size() const -> std::size_t {
+    return entries_.size();
+  }
+
+private:
+  static auto less(const entry& a, const entry& b) -> bool {
+    return std::tie(a.section, a.key) < std::tie(b.section, b.key);
+  }
+
+  static auto trim(std::string_view data) -> std::string_view {
+    const auto begin = data.find_first_not_of(" \t");
+    if (begin == std::string_view::npos) {
+      return {};
+    }
+    return data.substr(begin, data.find_last_not_of(" \t") - begin + 1);
+  }
+
+  void tokenize(std::string_view data) {
+    entries_.clear();
+    try {
+      tokenize_lines(data);
+    } catch (...) {
+      entries_.clear();
+      throw;
+    }
+    std::stable_sort(entries_.begin(), entries_.end(), less);
+  }
+
+  void tokenize_lines(std::string_view data) {
+    entries_.reserve(std::count(data.begin(), data.end(), '\n') + 1);
+
+    std::string_view section;
+    std::size_t number = 0;
+    for (const auto& text : lines(data)) {
+      number++;
+      const auto line = trim(text);
+      if (line.empty() || line.front() == ';' || line.front() == '#') {
+        continue;
+      }
+
+      if (line.front() == '[') {
+        if (line.back() != ']') {
+          throw error("invalid config section in line {}: {}", number, line);
+        }
+        section = trim(line.substr(1, line.size() - 2));
+        continue;
+      }
+
+      const auto pos = line.find('=');
+      const auto key = trim(line.substr(0, pos));
+      if (pos == std::string_view::npos || key.empty()) {
+        throw error("invalid config entry in line {}: {}", number, line);
+      }
+
+      auto value = trim(line.substr(pos + 1));
+      if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+        value = value.substr(1, value.size() - 2);
+      }
+      entries_.push_back({section, key, value});
+    }
+  }
+
+  filesystem::mapped_file file_;
+  std::vector<entry> entries_;
+};
+
+}  // namespace sh
@@ -0,0 +1,372 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <sh/env.h>
+#include <sh/error.h>
+#include <sh/filesystem.h>
+#include <sh/int.h>
+#include <sh/parse.h>
+
+#if SH_SIMD_AVX2
+#  include <immintrin.h>
+#elif SH_SIMD_SSE2
+#  include <emmintrin.h>
+#endif
+
+namespace sh::csv {
+
+namespace {
+
+constexpr u64 kRowEnd = u64(1) << 63;
+
+struct block_masks {
+  u64 quote;
+  u64 separator;
+  u64 newline;
+};
+
+#if SH_SIMD_AVX2
+
+inline auto equal_mask(const char* data, char value) -> u64 {
+  const auto needle = _mm256_set1_epi8(value);
+  const auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+  const auto hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32));
+  return static_cast<u32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)))
+    | u64(static_cast<u32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)))) << 32;
+}
+
+#elif SH_SIMD_SSE2
+
+inline auto equal_mask(const char* data, char value) -> u64 {
+  const auto needle = _mm_set1_epi8(value);
+  u64 mask = 0;
+  for (std::size_t i = 0; i < 4; ++i) {
+    const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i));
+    mask |= u64(static_cast<u32>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)))) << (16 * i);
+  }
+  return mask;
+}
+
+#else
+
+inline auto equal_mask(const char* data, char value) -> u64 {
+  u64 mask = 0;
+  for (std::size_t i = 0; i < 64; ++i) {
+    mask |= u64(data[i] == value) << i;
+  }
+  return mask;
+}
+
+#endif
+
+// Classifies 64 bytes at once, bit i belongs to data[i].
+inline auto classify(const char* data, char separator) -> block_masks {
+  return {equal_mask(data, '"'), equal_mask(data, separator), equal_mask(data, '\n')};
+}
+
+// Bit i of the result is the parity of the set bits up to and including i,
+// which marks the bytes between an opening and a closing quote.
+inline auto prefix_xor(u64 mask) -> u64 {
+  mask ^= mask << 1;
+  mask ^= mask << 2;
+  mask ^= mask << 4;
+  mask ^= mask << 8;
+  mask ^= mask << 16;
+  mask ^= mask << 32;
+  return mask;
+}
+
+// Appends the end offsets of all fields in [begin, end) to ends. Row ends
+// are marked with kRowEnd. The quoted flag is the quote state at begin.
+inline void index_fields(std::string_view data, std::size_t begin, std::size_t end, bool quoted, char separator, std::vector<u64>& ends) {
+  u64 carry = quoted ? ~u64(0) : 0;
+  const auto scan = [&](const char* block, std::size_t offset) {
+    const auto masks = classify(block, separator);
+    const auto inside = prefix_xor(masks.quote) ^ carry;
+    carry = u64(0) - (inside >> 63);
+
+    auto structural = (masks.separator | masks.newline) & ~inside;
+    while (structural) {
+      const auto bit = std::countr_zero(structural);
+      ends.push_back((offset + bit) | ((masks.newline >> bit) & 1 ? kRowEnd : 0));
+      structural &= structural - 1;
+    }
+  };
+
+  auto offset = begin;
+  for (; end - offset >= 64; offset += 64) {
+    scan(data.data() + offset, offset);
+  }
+  if (offset != end) {
+    char block[64] = {};
+    std::memcpy(block, data.data() + offset, end - offset);
+    scan(block, offset);
+  }
+}
+
+}  // namespace
+
+// Removes the quotes around a field and collapses escaped quotes.
+inline auto unescape(std::string_view field) -> std::string {
+  if (field.size() < 2 || field.front() != '"' || field.back() != '"') {
+    return std::string(field);
+  }
+  std::string value;
+  value.reserve(field.size() - 2);
+  for (std::size_t i = 1; i + 1 < field.size(); ++i) {
+    value.push_back(field[i]);
+    if (field[i] == '"' && field[i + 1] == '"') {
+      i++;
+    }
+  }
+  return value;
+}
+
+// Reads delimiter separated values. Opening indexes the whole buffer: a
+// quote mask is built for every 64 byte block, turned into a mask of quoted
+// regions with a prefix xor and used to drop separators and newlines inside
+// quotes. Fields are string_views into the buffer or mapped file, so the
+// data must outlive the reader when opened from a view.
+class reader {
+public:
+  class row {
+  public:
+    row(const reader* reader, std::size_t first, std::size_t last)
+      : reader_(reader), first_(first), last_(last) {}
+
+    [[nodiscard]] auto size() const -> std::size_t {
+      return last_ - first_;
+    }
+
+    // Returns the field without enclosing quotes. Escaped quotes inside are
+    // kept as they are, use csv::unescape on the raw field to remove them.
+    [[nodiscard]] auto operator[](std::size_t index) const -> std::string_view {
+      auto field = raw(index);
+      if (field.size() >= 2 && field.front() == '"' && field.back() == '"') {
+        field = field.substr(1, field.size() - 2);
+      }
+      return field;
+    }
+
+    // Returns the field as it appears in the data.
+    [[nodiscard]] auto raw(std::size_t index) const -> std::string_view {
+      if (index >= size()) {
+        throw error("csv field out of range: {}", index);
+      }
+      return reader_->field(first_ + index);
+    }
+
+    template<parsable T>
+    [[nodiscard]] auto get(std::size_t index) const -> std::optional<T> {
+      return index < size() ? sh::parse<T>((*this)[index]) : std::nullopt;
+    }
+
+  private:
+    const reader* reader_;
+    std::size_t first_;
+    std::size_t last_;
+  };
+
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = row;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+
+    iterator(const reader* reader, std::size_t index)
+      : reader_(reader), index_(index) {}
+
+    auto operator*() const -> value_type {
+      return (*reader_)[index_];
+    }
+
+    auto operator++() -> iterator& {
+      index_++;
+      return *this;
+    }
+
+    auto operator++(int) -> iterator {
+      auto copy = *this;
+      index_++;
+      return copy;
+    }
+
+    auto operator==(const iterator& other) const -> bool {
+      return index_ == other.index_;
+    }
+
+  private:
+    const reader* reader_ = nullptr;
+    std::size_t index_ = 0;
+  };
+
+  reader() = default;
+
+  // Indexes the data. With more than one thread the data is split into
+  // blocks which are indexed concurrently. Quote parities of the blocks are
+  // counted first, so every block starts with the exact quote state.
+  void parse(std::string_view data, char separator = ',', std::size_t threads = 1) {
+    file_.close();
+    build(data, separator, threads);
+  }
+
+  // Maps the file and indexes it like parse. The mapping is copy on write
+  // because sh::parse may temporarily modify the fields it parses.
+  auto open(const filesystem::path& file, char separator = ',', std::size_t threads = 1) -> filesystem::status {
+    if (const auto result = file_.open(file, filesystem::mapped_file::access::copy_on_write); result != filesystem::status::ok) {
+      data_ = {};
+      ends_.clear();
+      rows_.clear();
+      return result;
+    }
+    // The hint only speeds up the first scan, indexing works without it.
+    static_cast<void>(file_.advise(filesystem::mapped_file::advice::sequential));
+    build(file_.view(), separator, threads);
+    return filesystem::status::ok;
+  }
+
+  [[nodiscard]] auto size() const -> std::size_t {
+    return rows_.size();
+  }
+
+  [[nodiscard]] auto empty() const -> bool {
+    return rows_.empty();
+  }
+
+  [[nodiscard]] auto operator[](std::size_t index) const -> row {
+    return {this, index ? rows_[index - 1] : 0, rows_[index]};
+  }
+
+  [[nodiscard]] auto begin() const -> iterator {
+    return {this, 0};
+  }
+
+  [[nodiscard]] auto end() const -> iterator {
+    return {this, size()};
+  }
+
+  // Parses a column of every row starting at first. Throws on missing or
+  // invalid fields.
+  template<parsable T>
+  [[nodiscard]] auto column(std::size_t index, std::size_t first = 0) const -> std::vector<T> {
+    std::vector<T> values;
+    values.reserve(size() - std::min(first, size()));
+    for (auto i = first; i < size(); ++i) {
+      if (auto value = (*this)[i].template get<T>(index)) {
+        values.push_back(std::move(*value));
+      } else {
+        throw error("invalid csv field {} in row {}", index, i);
+      }
+    }
+    return values;
+  }
+
+private:
+  void build(std::string_view data, char separator, std::size_t threads) {
+    constexpr std::size_t kBlock = 64;
+
+    data_ = data;
+    ends_.clear();
+    rows_.clear();
+
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const auto chunk = (data.size() / threads + kBlock - 1) / kBlock * kBlock;
+    threads = chunk ? std::min(threads, (data.size() + chunk - 1) / chunk) : 1;
+
+    if (threads == 1) {
+      ends_.reserve(data.size() / 8);
+      index_fields(data, 0, data.size(), false, separator, ends_);
+    } else {
+      const auto bounds = [&](std::size_t i) {
+        return std::pair(i * chunk, std::min((i + 1) * chunk, data.size()));
+      };
+      const auto parallel = [&](auto&& work) {
+        std::exception_ptr exception;
+        std::mutex mutex;
+        std::vector<std::thread> pool;
+        for (std::size_t i = 1; i < threads; ++i) {
+          pool.emplace_back([&, i] {
+            try {
+              work(i);
+            } catch (...) {
+              std::lock_guard lock(mutex);
+              exception = std::current_exception();
+            }
+          });
+        }
+        work(0);
+        for (auto& thread : pool) {
+          thread.join();
+        }
+        if (exception) {
+          std::rethrow_exception(exception);
+        }
+      };
+
+      std::vector<u8> parity(threads);
+      parallel([&](std::size_t i) {
+        const auto [begin, end] = bounds(i);
+        parity[i] = std::count(data.begin() + begin, data.begin() + end, '"') & 1;
+      });
+
+      std::vector<std::vector<u64>> chunks(threads);
+      parallel([&](std::size_t i) {
+        const auto [begin, end] = bounds(i);
+        bool quoted = false;
+        for (std::size_t j = 0; j < i; ++j) {
+          quoted ^= parity[j];
+        }
+        chunks[i].reserve((end - begin) / 8);
+        index_fields(data, begin, end, quoted, separator, chunks[i]);
+      });
+
+      std::size_t total = 0;
+      for (const auto& ends : chunks) {
+        total += ends.size();
+      }
+      ends_.reserve(total + 1);
+      for (const auto& ends : chunks) {
+        ends_.insert(ends_.end(), ends.begin(), ends.end());
+      }
+    }
+
+    if (!data.empty() && (ends_.empty() || ends_.back() != ((data.size() - 1) | kRowEnd))) {
+      ends_.push_back(data.size() | kRowEnd);
+    }
+    for (std::size_t i = 0; i < ends_.size(); ++i) {
+      if (ends_[i] & kRowEnd) {
+        rows_.push_back(i + 1);
+      }
+    }
+  }
+
+  [[nodiscard]] auto field(std::size_t index) const -> std::string_view {
+    const auto begin = index ? (ends_[index - 1] & ~kRowEnd) + 1 : 0;
+    auto end = ends_[index] & ~kRowEnd;
+    if ((ends_[index] & kRowEnd) && end > begin && data_[end - 1] == '\r') {
+      end--;
+    }
+    return data_.substr(begin, end - begin);
+  }
+
+  filesystem::mapped_file file_;
+  std::string_view data_;
+  std::vector<u64> ends_;
+  std::vector<std::size_t> rows_;
+};
+
+}  // namespace sh::csv
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <sh/fmt.h>
+#include <sh/hash.h>
+#include <sh/parse.h>
+
+namespace sh {
+
+// Specialize with a static constexpr array of name/value pairs to register an enum:
+//
+// template<>
+// struct sh::enum_names<color> {
+//   static constexpr std::pair<std::string_view, color> names[] = {
+//     {"red",   color::red},
+//     {"green", color::green}
+//   };
+// };
+template<typename Enum>
+struct enum_names {
+  ~enum_names() = delete;
+};
+
+template<typename Enum>
+concept named_enum = std::is_enum_v<Enum> && std::destructible<enum_names<Enum>>;
+
+namespace detail {
+
+template<named_enum Enum>
+struct enum_table {
+  static constexpr const auto& kNames = enum_names<Enum>::names;
+  static constexpr auto kSize = std::size(kNames);
+
+  static constexpr auto kHash = perfect_hash<kSize>([] {
+    std::array<std::string_view, kSize> keys;
+    for (std::size_t i = 0; i < kSize; ++i) {
+      keys[i] = kNames[i].first;
+    }
+    return keys;
+  }());
+
+  static constexpr auto kDense = [] {
+    for (std::size_t i = 0; i < kSize; ++i) {
+      if (static_cast<std::size_t>(kNames[i].second) != i) {
+        return false;
+      }
+    }
+    return true;
+  }();
+
+  static constexpr auto kChoicesSize = [] {
+    std::size_t size = 0;
+    for (const auto& [name, value] : kNames) {
+      size += std::string_view(name).size() + 1;
+    }
+    return size ? size - 1 : 0;
+  }();
+
+  static constexpr auto kChoices = [] {
+    std::array<char, kChoicesSize + 1> choices{};
+    auto iter = choices.begin();
+    for (const auto& [name, value] : kNames) {
+      if (iter != choices.begin()) {
+        *iter++ = '|';
+      }
+      iter = std::copy(std::begin(std::string_view(name)), std::end(std::string_view(name)), iter);
+    }
+    return choices;
+  }();
+};
+
+}  // namespace detail
+
+template<named_enum Enum>
+constexpr auto enum_name(Enum value) -> std::optional<std::string_view> {
+  using table = detail::enum_table<Enum>;
+  if constexpr (table::kDense) {
+    const auto index = static_cast<std::size_t>(value);
+    if (index < table::kSize) {
+      return table::kNames[index].first;
+    }
+  } else {
+    for (const auto& [name, other] : table::kNames) {
+      if (value == other) {
+        return name;
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+template<named_enum Enum>
+constexpr auto enum_choices() -> std::string_view {
+  using table = detail::enum_table<Enum>;
+  return {table::kChoices.data(), table::kChoicesSize};
+}
+
+template<named_enum Enum>
+struct parser<Enum> {
+  constexpr auto parse(std::string_view data) -> std::optional<Enum> {
+    using table = detail::enum_table<Enum>;
+    const auto index = table::kHash.find(data);
+    if (index == table::kHash.npos) {
+      return std::nullopt;
+    }
+    return table::kNames[index].second;
+  }
+};
+
+}  // namespace sh
+
+template<sh::named_enum Enum>
+struct fmt::formatter<Enum> : fmt::formatter<std::string_view> {
+  template<typename FormatContext>
+  auto format(Enum value, FormatContext& ctx) {
+    if (const auto name = sh::enum_name(value)) {
+      return fmt::formatter<std::string_view>::format(*name, ctx);
+    }
+    return fmt::format_to(ctx.out(), "{}", static_cast<std::underlying_type_t<Enum>>(value));
+  }
+};
@@ -73,3 +73,15 @@
 #else
 #  define SH_OS_BSD_DRAGONFLY 0
 #endif
+
+#if defined(__AVX2__)
+#  define SH_SIMD_AVX2 1
+#else
+#  define SH_SIMD_AVX2 0
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define SH_SIMD_SSE2 1
+#else
+#  define SH_SIMD_SSE2 0
+#endif
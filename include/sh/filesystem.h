@@ -1,12 +1,35 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <climits>
+#include <condition_variable>
+#include <deque>
 #include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <thread>
 #include <tuple>
+#include <unordered_map>
+#include <vector>
+#include <sh/concepts.h>
 #include <sh/env.h>
+#include <sh/error.h>
 #include <sh/fmt.h>
+#include <sh/hash.h>
+#include <sh/int.h>
 #include <sh/parse.h>
+#include <sh/vector.h>
 #include <sh/windows.h>
 
 #if SH_OS_MACOS
@@ -16,6 +39,34 @@
 #  include <sys/types.h>
 #endif
 
+#if !SH_OS_WINDOWS
+#  include <cerrno>
+#  include <dirent.h>
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <sys/uio.h>
+#  include <unistd.h>
+#endif
+
+#if SH_OS_LINUX
+#  include <linux/fs.h>
+#  include <poll.h>
+#  include <sys/eventfd.h>
+#  include <sys/inotify.h>
+#  include <sys/ioctl.h>
+#  include <sys/sendfile.h>
+#  include <sys/syscall.h>
+#endif
+
+#if SH_OS_LINUX && __has_include(<linux/io_uring.h>)
+#  define SH_IO_URING 1
+#  include <linux/io_uring.h>
+#  include <sys/syscall.h>
+#else
+#  define SH_IO_URING 0
+#endif
+
 namespace sh::filesystem {
 
 using namespace std::filesystem;
@@ -36,12 +87,34 @@ concept resizable = requires(T&& t) {
   t.resize(std::size_t{});
 };
 
+template<typename T>
+concept resizable_for_overwrite = requires(T&& t) {
+  t.resize_for_overwrite(std::size_t{});
+};
+
 }  // namespace
 
-enum class status { ok, bad_file, bad_stream, bad_size };
+enum class status { ok, bad_file, bad_stream, bad_size, bad_map };
+
+namespace {
 
+template<contiguous_byte_container Container>
+auto fit(Container& dst, std::size_t size) -> bool {
+  if constexpr (resizable_for_overwrite<Container>) {
+    dst.resize_for_overwrite(size);
+  } else if constexpr (resizable<Container>) {
+    dst.resize(size);
+  }
+  return dst.size() == size;
+}
+
+}  // namespace
+
+// Reads a file into a container. Resizable containers keep their capacity,
+// which allows reusing one buffer across many reads.
 template<contiguous_byte_container Container>
 auto read(const path& file, Container& dst) -> status {
+#if SH_OS_WINDOWS
   std::ifstream stream(file, std::ios::binary);
   if (!stream.is_open()) {
     return status::bad_file;
@@ -49,25 +122,58 @@ auto read(const path& file, Container& dst) -> status {
     return status::bad_stream;
   }
 
-  const auto size = file_size(file);
-  if constexpr (resizable<Container>) {
-    dst.resize(size);
+  std::error_code ec;
+  const auto size = file_size(file, ec);
+  if (ec) {
+    return status::bad_stream;
   }
-  if (dst.size() != size) {
+  if (!fit(dst, size)) {
     return status::bad_size;
-  };
+  }
 
   stream.read(reinterpret_cast<char*>(dst.data()), size);
   if (!stream) {
     return status::bad_stream;
   }
   return status::ok;
+#else
+  const auto fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return status::bad_file;
+  }
+
+  struct stat stat;
+  if (fstat(fd, &stat) == -1) {
+    ::close(fd);
+    return status::bad_stream;
+  }
+  const auto size = static_cast<std::size_t>(stat.st_size);
+  if (!fit(dst, size)) {
+    ::close(fd);
+    return status::bad_size;
+  }
+
+  auto data = reinterpret_cast<char*>(dst.data());
+  auto remaining = size;
+  while (remaining > 0) {
+    const auto count = ::read(fd, data, remaining);
+    if (count > 0) {
+      data += count;
+      remaining -= count;
+    } else if (count == 0 || errno != EINTR) {
+      break;
+    }
+  }
+  ::close(fd);
+  return remaining == 0 ? status::ok : status::bad_stream;
+#endif
 }
 
 template<contiguous_byte_container Container>
 auto read(const path& file) -> std::tuple<status, Container> {
   Container data{};
-  return std::make_tuple(read(file, data), data);
+  const auto status = read(file, data);
+  return {status, std::move(data)};
 }
 
 template<contiguous_byte_container Container>
@@ -89,7 +195,1952 @@ auto write(const path& file, const Container& src) -> status {
   return status::ok;
 }
 
-inline auto program() -> path {
+// Writes a file through a single descriptor. Multiple buffers are gathered
+// into one system call. The durability mode decides what close() does:
+// nothing, flushing the data to disk, or writing to a temporary file which
+// atomically replaces the target once it is flushed.
+class writer {
+public:
+  enum class durability { none, sync, atomic };
+
+  writer() = default;
+
+  writer(writer&& other) noexcept {
+    *this = std::move(other);
+  }
+
+  writer(const writer&) = delete;
+
+  // Discards the temporary file of an uncommitted atomic writer.
+  ~writer() {
+    discard();
+  }
+
+  auto operator=(writer&& other) noexcept -> writer& {
+    if (this != &other) [[likely]] {
+      discard();
+      std::swap(handle_, other.handle_);
+      std::swap(durability_, other.durability_);
+      std::swap(file_, other.file_);
+      std::swap(temp_, other.temp_);
+    }
+    return *this;
+  }
+
+  auto operator=(const writer&) -> writer& = delete;
+
+  // Opens the file for writing. The preallocated size is reserved without
+  // changing the file size. Pass create_parent = false if the parent
+  // directory is known to exist.
+  auto open(const path& file, durability durability = durability::none, std::size_t preallocate = 0, bool create_parent = true) -> status {
+    discard();
+    if (create_parent) {
+      std::error_code ec;
+      create_directories(file.parent_path(), ec);
+    }
+
+    durability_ = durability;
+    file_ = file;
+    temp_.clear();
+    if (durability == durability::atomic) {
+      static std::atomic<u32> counter = 0;
+      temp_ = file;
+#if SH_OS_WINDOWS
+      temp_ += fmt::format(".{}.{}.tmp", GetCurrentProcessId(), counter++);
+#else
+      temp_ += fmt::format(".{}.{}.tmp", getpid(), counter++);
+#endif
+    }
+
+    const auto& target = temp_.empty() ? file_ : temp_;
+#if SH_OS_WINDOWS
+    handle_ = CreateFileW(target.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle_ == INVALID_HANDLE_VALUE) {
+      return status::bad_file;
+    }
+    if (preallocate) {
+      FILE_ALLOCATION_INFO info;
+      info.AllocationSize.QuadPart = static_cast<LONGLONG>(preallocate);
+      SetFileInformationByHandle(handle_, FileAllocationInfo, &info, sizeof(info));
+    }
+#else
+    handle_ = ::open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (handle_ == -1) {
+      return status::bad_file;
+    }
+#  if SH_OS_LINUX
+    if (preallocate) {
+      fallocate(handle_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(preallocate));
+    }
+#  endif
+#endif
+    return status::ok;
+  }
+
+  template<contiguous_byte_container... Containers>
+    requires not_empty<Containers...>
+  auto write(const Containers&... srcs) -> status {
+    if (!is_open()) {
+      return status::bad_file;
+    }
+#if SH_OS_WINDOWS
+    const auto write = [this](const void* data, std::size_t size) {
+      auto bytes = static_cast<const char*>(data);
+      while (size > 0) {
+        DWORD written;
+        const auto count = static_cast<DWORD>(std::min<std::size_t>(size, 1 << 30));
+        if (!WriteFile(handle_, bytes, count, &written, NULL)) {
+          return false;
+        }
+        bytes += written;
+        size -= written;
+      }
+      return true;
+    };
+    if (!(write(srcs.data(), srcs.size()) && ...)) {
+      return status::bad_stream;
+    }
+#else
+    iovec iov[] = {{const_cast<void*>(static_cast<const void*>(srcs.data())), srcs.size()}...};
+    std::span<iovec> pending(iov);
+    while (!pending.empty()) {
+      const auto count = ::writev(handle_, pending.data(), static_cast<int>(std::min<std::size_t>(pending.size(), IOV_MAX)));
+      if (count == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return status::bad_stream;
+      }
+
+      auto remaining = static_cast<std::size_t>(count);
+      while (!pending.empty() && remaining >= pending.front().iov_len) {
+        remaining -= pending.front().iov_len;
+        pending = pending.subspan(1);
+      }
+      if (remaining) {
+        pending.front().iov_base = static_cast<char*>(pending.front().iov_base) + remaining;
+        pending.front().iov_len -= remaining;
+      }
+    }
+#endif
+    return status::ok;
+  }
+
+  // Flushes and closes the file according to the durability mode.
+  auto close() -> status {
+    if (!is_open()) {
+      return status::ok;
+    }
+    auto result = status::ok;
+#if SH_OS_WINDOWS
+    if (durability_ != durability::none && !FlushFileBuffers(handle_)) {
+      result = status::bad_stream;
+    }
+    CloseHandle(handle_);
+    handle_ = INVALID_HANDLE_VALUE;
+    if (result == status::ok && !temp_.empty()) {
+      if (!MoveFileExW(temp_.c_str(), file_.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        result = status::bad_file;
+      }
+    }
+#else
+    if (durability_ != durability::none) {
+#  if SH_OS_LINUX
+      const auto synced = fdatasync(handle_) == 0;
+#  else
+      const auto synced = fsync(handle_) == 0;
+#  endif
+      if (!synced) {
+        result = status::bad_stream;
+      }
+    }
+    ::close(handle_);
+    handle_ = -1;
+    if (result == status::ok && !temp_.empty()) {
+      if (::rename(temp_.c_str(), file_.c_str()) == -1) {
+        result = status::bad_file;
+      } else {
+        const auto parent = file_.has_parent_path() ? file_.parent_path() : path(".");
+        const auto fd = ::open(parent.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd != -1) {
+          fsync(fd);
+          ::close(fd);
+        }
+      }
+    }
+#endif
+    if (result != status::ok && !temp_.empty()) {
+      std::error_code ec;
+      remove(temp_, ec);
+    }
+    temp_.clear();
+    return result;
+  }
+
+  [[nodiscard]] auto is_open() const -> bool {
+#if SH_OS_WINDOWS
+    return handle_ != INVALID_HANDLE_VALUE;
+#else
+    return handle_ != -1;
+#endif
+  }
+
+private:
+  void discard() {
+    if (!is_open()) {
+      return;
+    }
+#if SH_OS_WINDOWS
+    CloseHandle(handle_);
+    handle_ = INVALID_HANDLE_VALUE;
+#else
+    ::close(handle_);
+    handle_ = -1;
+#endif
+    if (!temp_.empty()) {
+      std::error_code ec;
+      remove(temp_, ec);
+      temp_.clear();
+    }
+  }
+
+#if SH_OS_WINDOWS
+  HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+  int handle_ = -1;
+#endif
+  durability durability_ = durability::none;
+  path file_;
+  path temp_;
+};
+
+// Reads a file in fixed-size chunks. A background thread reads ahead into a
+// ring of buffers, chunks are handed out in order and must be released in
+// the same order before their buffer is reused. Iterating the reader as a
+// range releases each chunk when advancing.
+class chunk_reader {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = std::span<const u8>;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+
+    explicit iterator(chunk_reader* reader)
+      : reader_(reader) {
+      advance();
+    }
+
+    auto operator*() const -> const value_type& {
+      return chunk_;
+    }
+
+    auto operator++() -> iterator& {
+      reader_->release();
+      advance();
+      return *this;
+    }
+
+    void operator++(int) {
+      ++*this;
+    }
+
+    auto operator==(std::default_sentinel_t) const -> bool {
+      return !reader_;
+    }
+
+  private:
+    void advance() {
+      if (const auto chunk = reader_->acquire()) {
+        chunk_ = *chunk;
+      } else {
+        reader_ = nullptr;
+      }
+    }
+
+    chunk_reader* reader_ = nullptr;
+    value_type chunk_;
+  };
+
+  chunk_reader() = default;
+  chunk_reader(const chunk_reader&) = delete;
+
+  ~chunk_reader() {
+    close();
+  }
+
+  auto operator=(const chunk_reader&) -> chunk_reader& = delete;
+
+  auto open(const path& file, std::size_t chunk_size = 1 << 20, std::size_t buffers = 4) -> status {
+    close();
+#if SH_OS_WINDOWS
+    handle_ = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (handle_ == INVALID_HANDLE_VALUE) {
+      std::lock_guard lock(mutex_);
+      return status_ = status::bad_file;
+    }
+#else
+    handle_ = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (handle_ == -1) {
+      std::lock_guard lock(mutex_);
+      return status_ = status::bad_file;
+    }
+#  if SH_OS_LINUX
+    posix_fadvise(handle_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#  endif
+#endif
+    buffers_.resize(std::max<std::size_t>(buffers, 2));
+    for (auto& buffer : buffers_) {
+      buffer.resize_for_overwrite(std::max<std::size_t>(chunk_size, 1));
+    }
+    sizes_.assign(buffers_.size(), 0);
+    produced_ = acquired_ = released_ = 0;
+    done_ = stop_ = false;
+    status_ = status::ok;
+    thread_ = std::thread([this] { run(); });
+    return status::ok;
+  }
+
+  // Stops reading ahead. Chunks which were not acquired yet are dropped
+  // and acquire() returns nothing until the reader is opened again.
+  void close() {
+    if (thread_.joinable()) {
+      {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+      }
+      condition_.notify_all();
+      thread_.join();
+    }
+    {
+      std::lock_guard lock(mutex_);
+      produced_ = acquired_;
+      done_ = true;
+    }
+#if SH_OS_WINDOWS
+    if (handle_ != INVALID_HANDLE_VALUE) {
+      CloseHandle(handle_);
+      handle_ = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (handle_ != -1) {
+      ::close(handle_);
+      handle_ = -1;
+    }
+#endif
+  }
+
+  // Waits for the next chunk. Returns nothing at the end of the file or
+  // after an error, see status().
+  auto acquire() -> std::optional<std::span<const u8>> {
+    std::unique_lock lock(mutex_);
+    condition_.wait(lock, [this] {
+      return produced_ > acquired_ || done_;
+    });
+    if (produced_ == acquired_) {
+      return std::nullopt;
+    }
+    const auto index = acquired_++ % buffers_.size();
+    return std::span<const u8>(buffers_[index].data(), sizes_[index]);
+  }
+
+  // Hands the oldest acquired chunk back for reuse.
+  void release() {
+    {
+      std::lock_guard lock(mutex_);
+      if (released_ < acquired_) {
+        released_++;
+      }
+    }
+    condition_.notify_all();
+  }
+
+  [[nodiscard]] auto status() const -> filesystem::status {
+    std::lock_guard lock(mutex_);
+    return status_;
+  }
+
+  [[nodiscard]] auto begin() -> iterator {
+    return iterator(this);
+  }
+
+  [[nodiscard]] auto end() const -> std::default_sentinel_t {
+    return {};
+  }
+
+private:
+  void run() {
+    while (true) {
+      std::size_t index;
+      {
+        std::unique_lock lock(mutex_);
+        condition_.wait(lock, [this] {
+          return produced_ - released_ < buffers_.size() || stop_;
+        });
+        if (stop_) {
+          break;
+        }
+        index = produced_ % buffers_.size();
+      }
+
+      auto& buffer = buffers_[index];
+      std::size_t size = 0;
+      auto failed = false;
+      while (size < buffer.size()) {
+#if SH_OS_WINDOWS
+        DWORD count = 0;
+        if (!ReadFile(handle_, buffer.data() + size, static_cast<DWORD>(std::min<std::size_t>(buffer.size() - size, 1 << 30)), &count, NULL)) {
+          failed = true;
+          break;
+        }
+#else
+        const auto count = ::read(handle_, buffer.data() + size, buffer.size() - size);
+        if (count == -1) {
+          if (errno == EINTR) {
+            continue;
+          }
+          failed = true;
+          break;
+        }
+#endif
+        if (count == 0) {
+          break;
+        }
+        size += count;
+      }
+
+      {
+        std::lock_guard lock(mutex_);
+        if (size > 0 && !failed) {
+          sizes_[index] = size;
+          produced_++;
+        }
+        if (failed) {
+          status_ = status::bad_stream;
+        }
+        if (failed || size < buffer.size()) {
+          done_ = true;
+        }
+      }
+      condition_.notify_all();
+      if (done_) {
+        break;
+      }
+    }
+  }
+
+#if SH_OS_WINDOWS
+  HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+  int handle_ = -1;
+#endif
+  std::vector<vector<u8>> buffers_;
+  std::vector<std::size_t> sizes_;
+  std::size_t produced_ = 0;
+  std::size_t acquired_ = 0;
+  std::size_t released_ = 0;
+  bool done_ = true;
+  bool stop_ = false;
+  filesystem::status status_ = status::ok;
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread thread_;
+};
+
+// Caches file contents as shared immutable buffers. On Linux cached files
+// are watched with inotify and dropped as soon as they change, otherwise
+// size and modification time are compared on every lookup. The least
+// recently used entries are evicted once the budget is exceeded.
+class file_cache {
+public:
+  using buffer = std::shared_ptr<const vector<u8>>;
+
+  explicit file_cache(std::size_t budget = 64 << 20)
+    : budget_(budget) {
+#if SH_OS_LINUX
+    inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wakeup_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotify_ != -1 && wakeup_ != -1) {
+      thread_ = std::thread([this] { watch(); });
+    }
+#endif
+  }
+
+  file_cache(const file_cache&) = delete;
+
+  ~file_cache() {
+#if SH_OS_LINUX
+    if (thread_.joinable()) {
+      const u64 value = 1;
+      static_cast<void>(::write(wakeup_, &value, sizeof(value)));
+      thread_.join();
+    }
+    if (inotify_ != -1) {
+      ::close(inotify_);
+    }
+    if (wakeup_ != -1) {
+      ::close(wakeup_);
+    }
+#endif
+  }
+
+  auto operator=(const file_cache&) -> file_cache& = delete;
+
+  // Files are read without holding the lock. A miss is only cached if no
+  // invalidation happened while it was read, the data is returned either way.
+  auto read(const path& file) -> std::tuple<status, buffer> {
+    {
+      std::lock_guard lock(mutex_);
+      if (const auto iter = entries_.find(file); iter != entries_.end()) {
+        auto& entry = iter->second;
+        if (entry.watch != -1 || entry.stamp == stamp(file)) {
+          lru_.splice(lru_.begin(), lru_, entry.lru);
+          return {status::ok, entry.data};
+        }
+        erase(iter);
+      }
+    }
+
+    // Watch before reading so that no change after the read goes unnoticed.
+    auto watch = -1;
+#if SH_OS_LINUX
+    if (thread_.joinable()) {
+      watch = inotify_add_watch(inotify_, file.c_str(), IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF);
+    }
+#endif
+    const auto epoch = [this] {
+      std::lock_guard lock(mutex_);
+      return epoch_;
+    }();
+    const auto stamp = watch == -1 ? this->stamp(file) : std::pair<s64, u64>{};
+    auto data = std::make_shared<vector<u8>>();
+    const auto result = filesystem::read(file, *data);
+
+    std::lock_guard lock(mutex_);
+    if (result != status::ok) {
+      unwatch(watch);
+      return {result, nullptr};
+    }
+    if (data->size() > budget_ || epoch != epoch_) {
+      unwatch(watch);
+      return {status::ok, std::move(data)};
+    }
+    if (const auto iter = entries_.find(file); iter != entries_.end()) {
+      unwatch(watch);
+      lru_.splice(lru_.begin(), lru_, iter->second.lru);
+      return {status::ok, iter->second.data};
+    }
+    memory_ += data->size();
+    while (memory_ > budget_) {
+      erase(entries_.find(lru_.back()));
+    }
+
+    lru_.push_front(file);
+    entries_.emplace(file, entry{data, watch, stamp, lru_.begin()});
+    if (watch != -1) {
+      watches_.emplace(watch, file);
+    }
+    return {status::ok, std::move(data)};
+  }
+
+  void invalidate(const path& file) {
+    std::lock_guard lock(mutex_);
+    epoch_++;
+    if (const auto iter = entries_.find(file); iter != entries_.end()) {
+      erase(iter);
+    }
+  }
+
+  void clear() {
+    std::lock_guard lock(mutex_);
+    epoch_++;
+    while (!entries_.empty()) {
+      erase(entries_.begin());
+    }
+  }
+
+  [[nodiscard]] auto size() const -> std::size_t {
+    std::lock_guard lock(mutex_);
+    return entries_.size();
+  }
+
+  [[nodiscard]] auto memory() const -> std::size_t {
+    std::lock_guard lock(mutex_);
+    return memory_;
+  }
+
+private:
+  struct path_hash {
+    auto operator()(const path& path) const -> std::size_t {
+      return hash_value(path);
+    }
+  };
+
+  struct entry {
+    buffer data;
+    int watch;
+    std::pair<s64, u64> stamp;
+    std::list<path>::iterator lru;
+  };
+
+  using entries = std::unordered_map<path, entry, path_hash>;
+
+  static auto stamp(const path& file) -> std::pair<s64, u64> {
+    std::error_code ec;
+    const auto time = last_write_time(file, ec).time_since_epoch().count();
+    const auto size = file_size(file, ec);
+    return {static_cast<s64>(time), ec ? u64(-1) : static_cast<u64>(size)};
+  }
+
+  void erase(entries::iterator iter) {
+    const auto watch = iter->second.watch;
+    memory_ -= iter->second.data->size();
+    lru_.erase(iter->second.lru);
+    entries_.erase(iter);
+
+    if (watch != -1) {
+      auto [first, last] = watches_.equal_range(watch);
+      for (; first != last; ++first) {
+        if (!entries_.contains(first->second)) {
+          watches_.erase(first);
+          break;
+        }
+      }
+      if (!watches_.contains(watch)) {
+        unwatch(watch);
+      }
+    }
+  }
+
+  void unwatch(int watch) {
+#if SH_OS_LINUX
+    if (watch != -1 && !watches_.contains(watch)) {
+      inotify_rm_watch(inotify_, watch);
+    }
+#endif
+  }
+
+#if SH_OS_LINUX
+  void watch() {
+    alignas(inotify_event) char buffer[4096];
+    pollfd fds[] = {{inotify_, POLLIN, 0}, {wakeup_, POLLIN, 0}};
+    while (true) {
+      if (poll(fds, 2, -1) == -1 && errno != EINTR) {
+        break;
+      }
+      if (fds[1].revents) {
+        break;
+      }
+
+      while (true) {
+        const auto size = ::read(inotify_, buffer, sizeof(buffer));
+        if (size <= 0) {
+          break;
+        }
+
+        std::lock_guard lock(mutex_);
+        epoch_++;
+        for (auto data = buffer; data < buffer + size;) {
+          const auto event = reinterpret_cast<const inotify_event*>(data);
+          data += sizeof(inotify_event) + event->len;
+
+          auto [first, last] = watches_.equal_range(event->wd);
+          std::vector<path> files;
+          for (; first != last; ++first) {
+            files.push_back(first->second);
+          }
+          for (const auto& file : files) {
+            if (const auto iter = entries_.find(file); iter != entries_.end()) {
+              if (event->mask & IN_IGNORED) {
+                iter->second.watch = -1;
+              }
+              erase(iter);
+            }
+          }
+          if (event->mask & IN_IGNORED) {
+            watches_.erase(event->wd);
+          }
+        }
+      }
+    }
+  }
+#endif
+
+  std::size_t budget_;
+  std::size_t memory_ = 0;
+  u64 epoch_ = 0;
+  entries entries_;
+  std::list<path> lru_;
+  std::unordered_multimap<int, path> watches_;
+  mutable std::mutex mutex_;
+#if SH_OS_LINUX
+  int inotify_ = -1;
+  int wakeup_ = -1;
+  std::thread thread_;
+#endif
+};
+
+// Maps a file into memory. Read-only and copy-on-write mappings are private,
+// read-write mappings write through to the file.
+class mapped_file {
+public:
+  enum class access { read_only, copy_on_write, read_write };
+  enum class advice { normal, sequential, random, willneed, hugepage };
+
+  mapped_file() = default;
+
+  mapped_file(mapped_file&& other) noexcept {
+    *this = std::move(other);
+  }
+
+  mapped_file(const mapped_file&) = delete;
+
+  ~mapped_file() {
+    close();
+  }
+
+  auto operator=(mapped_file&& other) noexcept -> mapped_file& {
+    if (this != &other) [[likely]] {
+      close();
+      std::swap(data_, other.data_);
+      std::swap(size_, other.size_);
+    }
+    return *this;
+  }
+
+  auto operator=(const mapped_file&) -> mapped_file& = delete;
+
+  auto open(const path& file, access access = access::read_only, bool populate = false) -> status {
+    close();
+    const auto write = access == access::read_write;
+#if SH_OS_WINDOWS
+    const auto handle = CreateFileW(
+      file.c_str(), write ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+      FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+      return status::bad_file;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(handle, &file_size)) {
+      CloseHandle(handle);
+      return status::bad_stream;
+    }
+    const auto size = static_cast<std::size_t>(file_size.QuadPart);
+    if (size == 0) {
+      CloseHandle(handle);
+      return status::ok;
+    }
+
+    DWORD protection = PAGE_READONLY;
+    DWORD view = FILE_MAP_READ;
+    if (access == access::copy_on_write) {
+      protection = PAGE_WRITECOPY;
+      view = FILE_MAP_COPY;
+    } else if (write) {
+      protection = PAGE_READWRITE;
+      view = FILE_MAP_WRITE;
+    }
+
+    const auto mapping = CreateFileMappingW(handle, NULL, protection, 0, 0, NULL);
+    CloseHandle(handle);
+    if (!mapping) {
+      return status::bad_map;
+    }
+
+    const auto data = MapViewOfFile(mapping, view, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data) {
+      return status::bad_map;
+    }
+#else
+    const auto fd = ::open(file.c_str(), (write ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+    if (fd == -1) {
+      return status::bad_file;
+    }
+
+    struct stat stat;
+    if (fstat(fd, &stat) == -1) {
+      ::close(fd);
+      return status::bad_stream;
+    }
+    const auto size = static_cast<std::size_t>(stat.st_size);
+    if (size == 0) {
+      ::close(fd);
+      return status::ok;
+    }
+
+    auto flags = write ? MAP_SHARED : MAP_PRIVATE;
+#  ifdef MAP_POPULATE
+    if (populate) {
+      flags |= MAP_POPULATE;
+    }
+#  endif
+    const auto protection = access == access::read_only ? PROT_READ : PROT_READ | PROT_WRITE;
+    const auto data = mmap(nullptr, size, protection, flags, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      return status::bad_map;
+    }
+#endif
+    data_ = static_cast<char*>(data);
+    size_ = size;
+#if SH_OS_WINDOWS || !defined(MAP_POPULATE)
+    if (populate) {
+      advise(advice::willneed);
+    }
+#endif
+    return status::ok;
+  }
+
+  void close() {
+    if (data_) {
+#if SH_OS_WINDOWS
+      UnmapViewOfFile(data_);
+#else
+      munmap(data_, size_);
+#endif
+    }
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  // Hints the expected access pattern. Unsupported hints are ignored.
+  auto advise(advice advice) -> status {
+    if (!data_) {
+      return status::ok;
+    }
+#if SH_OS_WINDOWS
+    if (advice == advice::willneed) {
+      WIN32_MEMORY_RANGE_ENTRY range = {data_, size_};
+      PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#else
+    auto native = MADV_NORMAL;
+    switch (advice) {
+      case advice::normal:     native = MADV_NORMAL;     break;
+      case advice::sequential: native = MADV_SEQUENTIAL; break;
+      case advice::random:     native = MADV_RANDOM;     break;
+      case advice::willneed:   native = MADV_WILLNEED;   break;
+      case advice::hugepage:
+#  ifdef MADV_HUGEPAGE
+        native = MADV_HUGEPAGE;
+        break;
+#  else
+        return status::ok;
+#  endif
+    }
+    if (madvise(data_, size_, native) == -1) {
+      return status::bad_map;
+    }
+#endif
+    return status::ok;
+  }
+
+  // Writes changes of a read-write mapping back to the file.
+  auto sync() -> status {
+    if (!data_) {
+      return status::ok;
+    }
+#if SH_OS_WINDOWS
+    if (!FlushViewOfFile(data_, 0)) {
+      return status::bad_stream;
+    }
+#else
+    if (msync(data_, size_, MS_SYNC) == -1) {
+      return status::bad_stream;
+    }
+#endif
+    return status::ok;
+  }
+
+  [[nodiscard]] auto data() -> char* {
+    return data_;
+  }
+
+  [[nodiscard]] auto data() const -> const char* {
+    return data_;
+  }
+
+  [[nodiscard]] auto size() const -> std::size_t {
+    return size_;
+  }
+
+  [[nodiscard]] auto empty() const -> bool {
+    return size_ == 0;
+  }
+
+  [[nodiscard]] auto view() const -> std::string_view {
+    return {data_, size_};
+  }
+
+  [[nodiscard]] auto bytes() -> std::span<u8> {
+    return {reinterpret_cast<u8*>(data_), size_};
+  }
+
+  [[nodiscard]] auto bytes() const -> std::span<const u8> {
+    return {reinterpret_cast<const u8*>(data_), size_};
+  }
+
+private:
+  char* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+namespace {
+
+// Releases read buffers which grew beyond this size after their file was
+// handed to the callback, so memory kept between files stays bounded.
+constexpr std::size_t kReadManyRetain = 4 << 20;
+
+inline void release_large(vector<u8>& buffer) {
+  if (buffer.capacity() > kReadManyRetain) {
+    buffer.clear();
+    buffer.shrink_to_fit();
+  }
+}
+
+#if SH_IO_URING
+
+// Minimal io_uring instance driven by raw system calls.
+class uring {
+public:
+  explicit uring(unsigned entries) {
+    io_uring_params params{};
+    fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ == -1) {
+      return;
+    }
+
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(u32);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    single_ = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_) {
+      sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+
+    sq_ = map(sq_size_, IORING_OFF_SQ_RING);
+    cq_ = single_ ? sq_ : map(cq_size_, IORING_OFF_CQ_RING);
+    sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+    if (!sq_ || !cq_ || !sqes_) {
+      close();
+      return;
+    }
+
+    sq_head_ = offset<u32>(sq_, params.sq_off.head);
+    sq_tail_ = offset<u32>(sq_, params.sq_off.tail);
+    sq_array_ = offset<u32>(sq_, params.sq_off.array);
+    sq_mask_ = *offset<u32>(sq_, params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    cq_head_ = offset<u32>(cq_, params.cq_off.head);
+    cq_tail_ = offset<u32>(cq_, params.cq_off.tail);
+    cqes_ = offset<io_uring_cqe>(cq_, params.cq_off.cqes);
+    cq_mask_ = *offset<u32>(cq_, params.cq_off.ring_mask);
+    tail_ = *sq_tail_;
+    submitted_ = tail_;
+  }
+
+  uring(const uring&) = delete;
+
+  ~uring() {
+    close();
+  }
+
+  auto operator=(const uring&) -> uring& = delete;
+
+  explicit operator bool() const {
+    return fd_ != -1;
+  }
+
+  auto supports(std::initializer_list<u8> ops) const -> bool {
+    constexpr auto kOps = 256;
+    alignas(io_uring_probe) u8 buffer[sizeof(io_uring_probe) + kOps * sizeof(io_uring_probe_op)]{};
+    const auto probe = reinterpret_cast<io_uring_probe*>(buffer);
+    if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, kOps) < 0) {
+      return false;
+    }
+    return std::all_of(ops.begin(), ops.end(), [probe](u8 op) {
+      return op <= probe->last_op && probe->ops[op].flags & IO_URING_OP_SUPPORTED;
+    });
+  }
+
+  auto push() -> io_uring_sqe* {
+    const auto head = std::atomic_ref(*sq_head_).load(std::memory_order_acquire);
+    if (tail_ - head == sq_entries_) {
+      return nullptr;
+    }
+    const auto index = tail_++ & sq_mask_;
+    sq_array_[index] = index;
+    std::memset(&sqes_[index], 0, sizeof(io_uring_sqe));
+    return &sqes_[index];
+  }
+
+  // Submits pushed entries and waits for at least one completion.
+  auto submit() -> bool {
+    std::atomic_ref(*sq_tail_).store(tail_, std::memory_order_release);
+    while (true) {
+      const auto result = syscall(__NR_io_uring_enter, fd_, tail_ - submitted_, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (result >= 0) {
+        submitted_ += static_cast<u32>(result);
+        return true;
+      } else if (errno != EINTR) {
+        return false;
+      }
+    }
+  }
+
+  template<typename Callback>
+  void reap(Callback&& callback) {
+    auto head = *cq_head_;
+    const auto tail = std::atomic_ref(*cq_tail_).load(std::memory_order_acquire);
+    for (; head != tail; ++head) {
+      const auto& cqe = cqes_[head & cq_mask_];
+      std::atomic_ref(*cq_head_).store(head + 1, std::memory_order_release);
+      callback(cqe.user_data, cqe.res);
+    }
+  }
+
+private:
+  template<typename T>
+  static auto offset(void* base, u32 offset) -> T* {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+  }
+
+  auto map(std::size_t size, off_t offset) -> void* {
+    const auto data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+    return data == MAP_FAILED ? nullptr : data;
+  }
+
+  void close() {
+    if (sqes_) {
+      munmap(sqes_, sqes_size_);
+    }
+    if (cq_ && !single_) {
+      munmap(cq_, cq_size_);
+    }
+    if (sq_) {
+      munmap(sq_, sq_size_);
+    }
+    if (fd_ != -1) {
+      ::close(fd_);
+    }
+    sq_ = cq_ = sqes_ = nullptr;
+    fd_ = -1;
+  }
+
+  int fd_ = -1;
+  bool single_ = false;
+  std::size_t sq_size_ = 0;
+  std::size_t cq_size_ = 0;
+  std::size_t sqes_size_ = 0;
+  void* sq_ = nullptr;
+  void* cq_ = nullptr;
+  io_uring_sqe* sqes_ = nullptr;
+  u32* sq_head_ = nullptr;
+  u32* sq_tail_ = nullptr;
+  u32* sq_array_ = nullptr;
+  u32 sq_mask_ = 0;
+  u32 sq_entries_ = 0;
+  u32* cq_head_ = nullptr;
+  u32* cq_tail_ = nullptr;
+  io_uring_cqe* cqes_ = nullptr;
+  u32 cq_mask_ = 0;
+  u32 tail_ = 0;
+  u32 submitted_ = 0;
+};
+
+template<typename Callback>
+auto read_many_uring(std::span<const path> files, Callback& callback, std::size_t in_flight) -> bool {
+  struct slot {
+    std::size_t index = 0;
+    int fd = -1;
+    std::size_t offset = 0;
+    vector<u8> buffer;
+  };
+
+  std::vector<slot> slots(std::min(in_flight, files.size()));
+  uring ring(static_cast<unsigned>(std::bit_ceil(slots.size())));
+  if (!ring || !ring.supports({IORING_OP_OPENAT, IORING_OP_READ})) {
+    return false;
+  }
+
+  std::size_t next = 0;
+  std::size_t active = 0;
+  std::size_t pending = 0;
+
+  const auto open = [&](std::size_t id) {
+    auto& slot = slots[id];
+    slot.index = next++;
+    slot.fd = -1;
+    slot.offset = 0;
+    pending++;
+    const auto sqe = ring.push();
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<u64>(files[slot.index].c_str());
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    sqe->user_data = id;
+  };
+
+  const auto read = [&](std::size_t id) {
+    auto& slot = slots[id];
+    pending++;
+    const auto sqe = ring.push();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = slot.fd;
+    sqe->addr = reinterpret_cast<u64>(slot.buffer.data() + slot.offset);
+    sqe->len = static_cast<u32>(std::min<std::size_t>(slot.buffer.size() - slot.offset, 1 << 30));
+    sqe->off = slot.offset;
+    sqe->user_data = id;
+  };
+
+  const auto finish = [&](std::size_t id, status result) {
+    auto& slot = slots[id];
+    if (slot.fd != -1) {
+      ::close(slot.fd);
+      slot.fd = -1;
+    }
+    const auto size = result == status::ok ? slot.buffer.size() : 0;
+    callback(files[slot.index], result, std::span<const u8>(slot.buffer.data(), size));
+    release_large(slot.buffer);
+    if (next < files.size()) {
+      open(id);
+    } else {
+      active--;
+    }
+  };
+
+  const auto complete = [&](u64 id, s32 result) {
+    auto& slot = slots[id];
+    pending--;
+    if (slot.fd == -1) {
+      if (result < 0) {
+        finish(id, status::bad_file);
+        return;
+      }
+      slot.fd = result;
+
+      struct stat stat;
+      if (fstat(slot.fd, &stat) == -1) {
+        finish(id, status::bad_stream);
+        return;
+      }
+      slot.buffer.resize_for_overwrite(static_cast<std::size_t>(stat.st_size));
+      if (slot.buffer.empty()) {
+        finish(id, status::ok);
+      } else {
+        read(id);
+      }
+    } else {
+      if (result == -EINTR || result == -EAGAIN) {
+        read(id);
+      } else if (result <= 0) {
+        finish(id, status::bad_stream);
+      } else if ((slot.offset += result) < slot.buffer.size()) {
+        read(id);
+      } else {
+        finish(id, status::ok);
+      }
+    }
+  };
+
+  // Waits for outstanding requests before the buffers go away, the kernel
+  // would write into freed memory otherwise. Files opened in the meantime
+  // are closed.
+  const auto drain = [&] {
+    while (pending > 0 && ring.submit()) {
+      ring.reap([&](u64 id, s32 result) {
+        pending--;
+        if (slots[id].fd == -1 && result >= 0) {
+          ::close(result);
+        }
+      });
+    }
+    for (auto& slot : slots) {
+      if (slot.fd != -1) {
+        ::close(slot.fd);
+        slot.fd = -1;
+      }
+    }
+  };
+
+  try {
+    for (; active < slots.size(); ++active) {
+      open(active);
+    }
+    while (active > 0) {
+      if (!ring.submit()) {
+        throw error("io_uring_enter failed: {}", std::strerror(errno));
+      }
+      ring.reap(complete);
+    }
+  } catch (...) {
+    drain();
+    throw;
+  }
+  return true;
+}
+
+#endif
+
+template<typename Callback>
+void read_many_threaded(std::span<const path> files, Callback& callback, std::size_t in_flight) {
+  const auto threads = std::min({in_flight, files.size(), std::size_t{std::max(4u, std::thread::hardware_concurrency())}});
+
+  std::atomic<std::size_t> next = 0;
+  std::mutex mutex;
+  std::exception_ptr exception;
+
+  const auto work = [&] {
+    vector<u8> buffer;
+    for (auto index = next++; index < files.size(); index = next++) {
+      const auto result = read(files[index], buffer);
+      const auto size = result == status::ok ? buffer.size() : 0;
+
+      std::lock_guard lock(mutex);
+      if (exception) {
+        break;
+      }
+      try {
+        callback(files[index], result, std::span<const u8>(buffer.data(), size));
+      } catch (...) {
+        exception = std::current_exception();
+        next = files.size();
+      }
+      release_large(buffer);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (std::size_t i = 1; i < threads; ++i) {
+    pool.emplace_back(work);
+  }
+  work();
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
+
+}  // namespace
+
+// Reads many files with up to in_flight reads at a time. The callback is
+// called once per file as it completes, never concurrently, and the data is
+// only valid during the call. Uses io_uring where the kernel supports it and
+// a thread pool otherwise. Every file is read into memory as a whole, so the
+// peak memory use is about in_flight times the largest file, buffers above
+// a few megabytes are released once their file has been handed out.
+template<typename Callback>
+  requires std::invocable<Callback&, const path&, status, std::span<const u8>>
+void read_many(std::span<const path> files, Callback&& callback, std::size_t in_flight = 64) {
+  if (files.empty()) {
+    return;
+  }
+  in_flight = std::max<std::size_t>(in_flight, 1);
+#if SH_IO_URING
+  if (read_many_uring(files, callback, in_flight)) {
+    return;
+  }
+#endif
+  read_many_threaded(files, callback, in_flight);
+}
+
+using copy_progress = std::function<void(u64 copied, u64 total)>;
+
+// Copies a file inside the kernel where possible. On Linux a reflink is
+// tried first, then copy_file_range, sendfile and finally a pread/pwrite
+// loop. The progress callback is invoked after every chunk.
+inline auto copy_file_fast(const path& src, const path& dst, const copy_progress& progress = {}) -> std::tuple<status, u64> {
+#if SH_OS_WINDOWS
+  struct context {
+    const copy_progress& progress;
+    u64 copied;
+  } context{progress, 0};
+
+  const auto routine = [](LARGE_INTEGER total, LARGE_INTEGER copied, LARGE_INTEGER, LARGE_INTEGER, DWORD, DWORD, HANDLE, HANDLE, LPVOID data) -> DWORD {
+    auto& context = *static_cast<struct context*>(data);
+    context.copied = static_cast<u64>(copied.QuadPart);
+    if (context.progress) {
+      context.progress(context.copied, static_cast<u64>(total.QuadPart));
+    }
+    return PROGRESS_CONTINUE;
+  };
+
+  if (!CopyFileExW(src.c_str(), dst.c_str(), routine, &context, NULL, 0)) {
+    return {status::bad_file, context.copied};
+  }
+  return {status::ok, context.copied};
+#else
+  const auto in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in == -1) {
+    return {status::bad_file, 0};
+  }
+
+  struct stat stat;
+  if (fstat(in, &stat) == -1) {
+    ::close(in);
+    return {status::bad_stream, 0};
+  }
+
+  // Truncate only after making sure both paths are different files, copying
+  // a file onto itself would empty it.
+  const auto out = ::open(dst.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, stat.st_mode & 0777);
+  if (out == -1) {
+    ::close(in);
+    return {status::bad_file, 0};
+  }
+
+  struct stat out_stat;
+  if (fstat(out, &out_stat) == -1 || (out_stat.st_dev == stat.st_dev && out_stat.st_ino == stat.st_ino) || ftruncate(out, 0) == -1) {
+    ::close(in);
+    ::close(out);
+    return {status::bad_file, 0};
+  }
+
+  constexpr std::size_t kChunk = 64 << 20;
+  const auto total = static_cast<u64>(stat.st_size);
+  u64 copied = 0;
+  const auto report = [&] {
+    if (progress) {
+      progress(copied, total);
+    }
+  };
+
+  const auto finish = [&](status result) -> std::tuple<status, u64> {
+    ::close(in);
+    if (::close(out) == -1 && result == status::ok) {
+      result = status::bad_stream;
+    }
+    return {result, copied};
+  };
+
+#  if SH_OS_LINUX
+#    ifdef FICLONE
+  if (total > 0 && ioctl(out, FICLONE, in) == 0) {
+    copied = total;
+    report();
+    return finish(status::ok);
+  }
+#    endif
+
+  // Kernel copies which fall back to the next method when unsupported.
+  const auto kernel = [&](auto&& copy) -> std::optional<status> {
+    while (copied < total) {
+      const auto count = copy(std::min<u64>(total - copied, kChunk));
+      if (count > 0) {
+        copied += count;
+        report();
+      } else if (count == 0) {
+        break;
+      } else if (errno == EINTR) {
+        continue;
+      } else if (copied == 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+        return std::nullopt;
+      } else {
+        return status::bad_stream;
+      }
+    }
+    return status::ok;
+  };
+
+  if (const auto result = kernel([&](u64 size) {
+    return copy_file_range(in, nullptr, out, nullptr, size, 0);
+  })) {
+    return finish(*result);
+  }
+  if (const auto result = kernel([&](u64 size) {
+    return sendfile(out, in, nullptr, size);
+  })) {
+    return finish(*result);
+  }
+#  endif
+
+  vector<char> buffer;
+  buffer.resize_for_overwrite(std::min<std::size_t>(std::max<u64>(total, 1), 1 << 20));
+  while (true) {
+    const auto count = pread(in, buffer.data(), buffer.size(), static_cast<off_t>(copied));
+    if (count == 0) {
+      break;
+    } else if (count == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return finish(status::bad_stream);
+    }
+
+    for (ssize_t written = 0; written < count;) {
+      const auto result = pwrite(out, buffer.data() + written, count - written, static_cast<off_t>(copied + written));
+      if (result == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return finish(status::bad_stream);
+      }
+      written += result;
+    }
+    copied += count;
+    report();
+  }
+  return finish(status::ok);
+#endif
+}
+
+// Renames a file and falls back to copying and removing the source when
+// both paths are on different devices.
+inline auto move_file_fast(const path& src, const path& dst, const copy_progress& progress = {}) -> status {
+  std::error_code ec;
+  rename(src, dst, ec);
+  if (!ec) {
+    return status::ok;
+  } else if (ec != std::errc::cross_device_link) {
+    return status::bad_file;
+  }
+
+  const auto [result, copied] = copy_file_fast(src, dst, progress);
+  if (result != status::ok) {
+    return result;
+  }
+  remove(src, ec);
+  return ec ? status::bad_file : status::ok;
+}
+
+namespace {
+
+// Returns the ']' closing the class which starts at pos. Like in shells a
+// ']' directly after '[' or "[!" is part of the class.
+inline auto glob_class_end(std::string_view pattern, std::size_t pos) -> std::size_t {
+  auto first = pos + 1;
+  if (first < pattern.size() && pattern[first] == '!') {
+    first++;
+  }
+  return pattern.find(']', first + 1);
+}
+
+}  // namespace
+
+// Matches a name against a glob pattern supporting *, ? and [...] classes
+// with ranges and ! negation. Several patterns can be separated by ';'
+// outside of classes. A '[' without a closing ']' matches itself.
+inline auto glob(std::string_view pattern, std::string_view name) -> bool {
+  for (std::size_t i = 0; i < pattern.size(); ++i) {
+    if (pattern[i] == '[') {
+      if (const auto end = glob_class_end(pattern, i); end != std::string_view::npos) {
+        i = end;
+      }
+    } else if (pattern[i] == ';') {
+      return glob(pattern.substr(0, i), name) || glob(pattern.substr(i + 1), name);
+    }
+  }
+
+  std::size_t p = 0;
+  std::size_t n = 0;
+  auto star_p = std::string_view::npos;
+  auto star_n = std::string_view::npos;
+  while (n < name.size()) {
+    if (p < pattern.size() && pattern[p] == '*') {
+      star_p = p++;
+      star_n = n;
+      continue;
+    }
+
+    auto matched = false;
+    auto next = p + 1;
+    if (p < pattern.size()) {
+      if (pattern[p] == '?') {
+        matched = true;
+      } else if (pattern[p] == '[' && (next = glob_class_end(pattern, p)) != std::string_view::npos) {
+        auto first = p + 1;
+        const auto negate = pattern[first] == '!';
+        first += negate;
+        for (auto i = first; i < next; ++i) {
+          if (i + 2 < next && pattern[i + 1] == '-') {
+            matched |= name[n] >= pattern[i] && name[n] <= pattern[i + 2];
+            i += 2;
+          } else {
+            matched |= name[n] == pattern[i];
+          }
+        }
+        matched ^= negate;
+        next++;
+      } else {
+        next = p + 1;
+        matched = pattern[p] == name[n];
+      }
+    }
+
+    if (matched) {
+      p = next;
+      n++;
+    } else if (star_p != std::string_view::npos) {
+      p = star_p + 1;
+      n = ++star_n;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') {
+    p++;
+  }
+  return p == pattern.size();
+}
+
+struct scan_entry {
+  path file;
+  file_type type;
+};
+
+namespace {
+
+template<typename Callback>
+void scan_directory(const path& directory, Callback&& callback) {
+#if SH_OS_LINUX
+  const auto fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1) {
+    return;
+  }
+
+  struct dirent64 {
+    u64 ino;
+    s64 off;
+    unsigned short reclen;
+    unsigned char type;
+    char name[1];
+  };
+
+  alignas(dirent64) char buffer[32 * 1024];
+  while (true) {
+    const auto size = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+    if (size <= 0) {
+      break;
+    }
+    for (auto data = buffer; data < buffer + size;) {
+      const auto entry = reinterpret_cast<const dirent64*>(data);
+      data += entry->reclen;
+
+      const std::string_view name(entry->name);
+      if (name == "." || name == "..") {
+        continue;
+      }
+
+      auto type = file_type::unknown;
+      switch (entry->type) {
+        case DT_REG:  type = file_type::regular;   break;
+        case DT_DIR:  type = file_type::directory; break;
+        case DT_LNK:  type = file_type::symlink;   break;
+        case DT_BLK:  type = file_type::block;     break;
+        case DT_CHR:  type = file_type::character; break;
+        case DT_FIFO: type = file_type::fifo;      break;
+        case DT_SOCK: type = file_type::socket;    break;
+        default: {
+          struct stat stat;
+          if (fstatat(fd, entry->name, &stat, AT_SYMLINK_NOFOLLOW) == 0) {
+            if (S_ISREG(stat.st_mode)) {
+              type = file_type::regular;
+            } else if (S_ISDIR(stat.st_mode)) {
+              type = file_type::directory;
+            } else if (S_ISLNK(stat.st_mode)) {
+              type = file_type::symlink;
+            }
+          }
+          break;
+        }
+      }
+      callback(name, type);
+    }
+  }
+  ::close(fd);
+#else
+  std::error_code ec;
+  for (directory_iterator iter(directory, directory_options::skip_permission_denied, ec), last; !ec && iter != last; iter.increment(ec)) {
+    callback(iter->path().filename().string(), iter->symlink_status(ec).type());
+  }
+#endif
+}
+
+}  // namespace
+
+// Walks a directory tree in parallel. Every worker owns a queue of
+// directories and steals from the others when it runs empty. Entries which
+// are not directories and match the glob filter are passed to the visitor
+// in batches. Visitor calls are never concurrent. Symlinks are not followed
+// and unreadable directories are skipped. The first exception of a worker
+// or the visitor stops the walk and is rethrown after all workers joined.
+template<typename Visitor>
+  requires std::invocable<Visitor&, std::span<const scan_entry>>
+void scan(const path& root, std::string_view filter, Visitor&& visitor, std::size_t threads = 0) {
+  constexpr std::size_t kBatch = 256;
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  struct queue {
+    std::mutex mutex;
+    std::deque<path> directories;
+  };
+
+  std::vector<queue> queues(threads);
+  std::atomic<std::size_t> pending = 1;
+  std::atomic<bool> stop = false;
+  std::mutex mutex;
+  std::exception_ptr exception;
+  queues[0].directories.push_back(root);
+
+  // Idle workers sleep until directories are queued or the walk is done.
+  // The count is changed while holding the lock of the queue which gains or
+  // loses the directory, so it never disagrees with the queues.
+  std::mutex idle_mutex;
+  std::condition_variable idle;
+  std::size_t queued = 1;
+
+  const auto wake = [&] {
+    std::lock_guard lock(idle_mutex);
+    idle.notify_all();
+  };
+
+  const auto fail = [&] {
+    {
+      std::lock_guard lock(mutex);
+      if (!exception) {
+        exception = std::current_exception();
+      }
+    }
+    stop = true;
+    wake();
+  };
+
+  const auto flush = [&](std::vector<scan_entry>& batch) {
+    if (batch.empty()) {
+      return;
+    }
+    std::lock_guard lock(mutex);
+    if (!exception) {
+      try {
+        visitor(std::span<const scan_entry>(batch));
+      } catch (...) {
+        exception = std::current_exception();
+        stop = true;
+        wake();
+      }
+    }
+    batch.clear();
+  };
+
+  const auto pop = [&](std::size_t id) -> std::optional<path> {
+    for (std::size_t i = 0; i < threads; ++i) {
+      auto& queue = queues[(id + i) % threads];
+      std::unique_lock lock(queue.mutex);
+      if (!queue.directories.empty()) {
+        path directory;
+        if (i == 0) {
+          directory = std::move(queue.directories.back());
+          queue.directories.pop_back();
+        } else {
+          directory = std::move(queue.directories.front());
+          queue.directories.pop_front();
+        }
+        std::lock_guard idle_lock(idle_mutex);
+        queued--;
+        return directory;
+      }
+    }
+    return std::nullopt;
+  };
+
+  const auto push = [&](std::size_t id, path directory) {
+    pending++;
+    auto& queue = queues[id];
+    std::lock_guard lock(queue.mutex);
+    queue.directories.push_back(std::move(directory));
+    std::lock_guard idle_lock(idle_mutex);
+    queued++;
+    idle.notify_one();
+  };
+
+  const auto work = [&](std::size_t id) {
+    try {
+      std::vector<scan_entry> batch;
+      batch.reserve(kBatch);
+      while (pending > 0 && !stop) {
+        const auto directory = pop(id);
+        if (!directory) {
+          std::unique_lock lock(idle_mutex);
+          idle.wait(lock, [&] {
+            return queued > 0 || pending == 0 || stop;
+          });
+          continue;
+        }
+
+        scan_directory(*directory, [&](std::string_view name, file_type type) {
+          if (type == file_type::directory) {
+            push(id, *directory / name);
+          } else if (filter.empty() || glob(filter, name)) {
+            batch.push_back({*directory / name, type});
+            if (batch.size() == kBatch) {
+              flush(batch);
+            }
+          }
+        });
+        if (--pending == 0 || stop) {
+          wake();
+        }
+      }
+      flush(batch);
+    } catch (...) {
+      fail();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (std::size_t i = 1; i < threads; ++i) {
+    pool.emplace_back(work, i);
+  }
+  work(0);
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
+
+// Records size, modification time, inode and content hash of every file
+// below a root. Hashes are only computed for files whose metadata differs
+// from a previous snapshot. Snapshots are stored as fixed-size records
+// followed by the names, loading maps the file and reads it in place.
+class snapshot {
+public:
+  struct entry {
+    u64 size;
+    s64 mtime;
+    u64 inode;
+    u64 hash;
+    u64 name_offset;
+    u64 name_size;
+  };
+
+  static auto capture(const path& root, std::string_view filter = {}, const snapshot& previous = {}) -> snapshot {
+    std::vector<path> files;
+    scan(root, filter, [&](std::span<const scan_entry> entries) {
+      for (const auto& entry : entries) {
+        if (entry.type == file_type::regular) {
+          files.push_back(entry.file);
+        }
+      }
+    });
+
+    std::vector<std::string> names(files.size());
+    for (std::size_t i = 0; i < files.size(); ++i) {
+      names[i] = files[i].lexically_relative(root).generic_string();
+    }
+
+    std::vector<std::size_t> order(files.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+      return names[a] < names[b];
+    });
+
+    snapshot snapshot;
+    snapshot.entries_.resize(files.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      const auto& name = names[order[i]];
+      auto& entry = snapshot.entries_[i];
+      entry.name_offset = snapshot.names_.size();
+      entry.name_size = name.size();
+      snapshot.names_ += name;
+    }
+
+    std::atomic<std::size_t> next = 0;
+    const auto work = [&] {
+      for (auto i = next++; i < order.size(); i = next++) {
+        auto& entry = snapshot.entries_[i];
+        const auto& file = files[order[i]];
+        if (!stat(file, entry)) {
+          continue;
+        }
+
+        const auto old = previous.find(snapshot.name(entry));
+        if (old && old->size == entry.size && old->mtime == entry.mtime && old->inode == entry.inode) {
+          entry.hash = old->hash;
+        } else {
+          mapped_file mapped;
+          if (mapped.open(file) == status::ok) {
+            static_cast<void>(mapped.advise(mapped_file::advice::sequential));
+            entry.hash = murmur(mapped.data(), mapped.size(), 0);
+          }
+        }
+      }
+    };
+
+    const auto threads = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), order.size());
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < threads; ++i) {
+      pool.emplace_back(work);
+    }
+    work();
+    for (auto& thread : pool) {
+      thread.join();
+    }
+    return snapshot;
+  }
+
+  auto save(const path& file) const -> status {
+    const auto entries = this->entries();
+    const auto names = this->names();
+    const header header{kMagic, kVersion, entries.size(), names.size()};
+
+    writer writer;
+    if (const auto result = writer.open(file, writer::durability::atomic); result != status::ok) {
+      return result;
+    }
+    const std::span<const char> header_bytes(reinterpret_cast<const char*>(&header), sizeof(header));
+    const std::span<const char> entry_bytes(reinterpret_cast<const char*>(entries.data()), entries.size_bytes());
+    if (const auto result = writer.write(header_bytes, entry_bytes, names); result != status::ok) {
+      return result;
+    }
+    return writer.close();
+  }
+
+  auto load(const path& file) -> status {
+    entries_.clear();
+    names_.clear();
+    if (const auto result = file_.open(file); result != status::ok) {
+      return result;
+    }
+
+    header header;
+    if (file_.size() < sizeof(header)) {
+      file_.close();
+      return status::bad_size;
+    }
+    std::memcpy(&header, file_.data(), sizeof(header));
+    const auto body = file_.size() - sizeof(header);
+    if (header.magic != kMagic || header.version != kVersion
+        || header.entries > body / sizeof(entry)
+        || header.names != body - header.entries * sizeof(entry)) {
+      file_.close();
+      return status::bad_size;
+    }
+    for (const auto& entry : entries()) {
+      if (entry.name_offset > header.names || entry.name_size > header.names - entry.name_offset) {
+        file_.close();
+        return status::bad_size;
+      }
+    }
+    return status::ok;
+  }
+
+  [[nodiscard]] auto entries() const -> std::span<const entry> {
+    if (file_.empty()) {
+      return entries_;
+    }
+    const auto& header = *reinterpret_cast<const struct header*>(file_.data());
+    return {reinterpret_cast<const entry*>(file_.data() + sizeof(header)), header.entries};
+  }
+
+  [[nodiscard]] auto name(const entry& entry) const -> std::string_view {
+    return names().substr(entry.name_offset, entry.name_size);
+  }
+
+  [[nodiscard]] auto find(std::string_view name) const -> const entry* {
+    const auto entries = this->entries();
+    const auto iter = std::lower_bound(entries.begin(), entries.end(), name, [this](const entry& entry, std::string_view name) {
+      return this->name(entry) < name;
+    });
+    return iter != entries.end() && this->name(*iter) == name ? &*iter : nullptr;
+  }
+
+  [[nodiscard]] auto size() const -> std::size_t {
+    return entries().size();
+  }
+
+private:
+  static constexpr u32 kMagic = 0x5353'4853;
+  static constexpr u32 kVersion = 1;
+
+  struct header {
+    u32 magic;
+    u32 version;
+    u64 entries;
+    u64 names;
+  };
+
+  static auto stat(const path& file, entry& entry) -> bool {
+#if SH_OS_WINDOWS
+    std::error_code ec;
+    entry.size = file_size(file, ec);
+    entry.mtime = last_write_time(file, ec).time_since_epoch().count();
+    entry.inode = 0;
+    return !ec;
+#else
+    struct stat stat;
+    if (::stat(file.c_str(), &stat) == -1) {
+      return false;
+    }
+    entry.size = static_cast<u64>(stat.st_size);
+#  if SH_OS_MACOS
+    entry.mtime = static_cast<s64>(stat.st_mtimespec.tv_sec) * 1'000'000'000 + stat.st_mtimespec.tv_nsec;
+#  else
+    entry.mtime = static_cast<s64>(stat.st_mtim.tv_sec) * 1'000'000'000 + stat.st_mtim.tv_nsec;
+#  endif
+    entry.inode = static_cast<u64>(stat.st_ino);
+    return true;
+#endif
+  }
+
+  auto names() const -> std::string_view {
+    if (file_.empty()) {
+      return names_;
+    }
+    const auto entries = this->entries();
+    const auto offset = sizeof(header) + entries.size_bytes();
+    return {file_.data() + offset, file_.size() - offset};
+  }
+
+  std::vector<entry> entries_;
+  std::string names_;
+  mapped_file file_;
+};
+
+struct snapshot_diff {
+  std::vector<std::string> added;
+  std::vector<std::string> removed;
+  std::vector<std::string> modified;
+};
+
+// Compares two snapshots by name. Files count as modified if their size or
+// content hash changed.
+inline auto diff(const snapshot& old, const snapshot& now) -> snapshot_diff {
+  snapshot_diff diff;
+  const auto a = old.entries();
+  const auto b = now.entries();
+  std::size_t i = 0;
+  std::size_t j = 0;
+  while (i < a.size() || j < b.size()) {
+    if (j == b.size() || (i < a.size() && old.name(a[i]) < now.name(b[j]))) {
+      diff.removed.emplace_back(old.name(a[i++]));
+    } else if (i == a.size() || now.name(b[j]) < old.name(a[i])) {
+      diff.added.emplace_back(now.name(b[j++]));
+    } else {
+      if (a[i].size != b[j].size || a[i].hash != b[j].hash) {
+        diff.modified.emplace_back(now.name(b[j]));
+      }
+      i++;
+      j++;
+    }
+  }
+  return diff;
+}
+
+namespace {
+
+inline auto program_path() -> path {
 #if SH_OS_WINDOWS
   WCHAR buffer[MAX_PATH];
   GetModuleFileNameW(NULL, buffer, MAX_PATH);
@@ -121,10 +2172,57 @@ inline auto program() -> path {
 #endif
 }
 
+}  // namespace
+
+// The program path and directory are queried once on first use.
+inline auto program() -> const path& {
+  static const auto program = program_path();
+  return program;
+}
+
+inline auto program_directory() -> const path& {
+  static const auto directory = program().parent_path();
+  return directory;
+}
+
 inline auto absolute(const path& path) -> filesystem::path {
-  return path.is_relative() ? program().parent_path() / path : path;
+  return path.is_relative() ? program_directory() / path : path;
+}
+
+inline auto absolute(std::span<const path> paths) -> std::vector<path> {
+  std::vector<path> result;
+  result.reserve(paths.size());
+  for (const auto& path : paths) {
+    result.push_back(filesystem::absolute(path));
+  }
+  return result;
 }
 
+// Interns absolute paths of program resources. Each path is resolved once,
+// later lookups return a reference to the same path.
+class path_cache {
+public:
+  auto operator()(std::string_view file) -> const path& {
+    {
+      std::shared_lock lock(mutex_);
+      if (const auto iter = paths_.find(file); iter != paths_.end()) {
+        return iter->second;
+      }
+    }
+    std::unique_lock lock(mutex_);
+    return paths_.try_emplace(std::string(file), filesystem::absolute(u8path(file))).first->second;
+  }
+
+  [[nodiscard]] auto size() const -> std::size_t {
+    std::shared_lock lock(mutex_);
+    return paths_.size();
+  }
+
+private:
+  std::unordered_map<std::string, path, string_hash, std::equal_to<>> paths_;
+  mutable std::shared_mutex mutex_;
+};
+
 inline auto absolute(const path& path, std::error_code&) -> filesystem::path {
   return filesystem::absolute(path);
 }
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <sh/vector.h>
+
 #ifndef FMT_HEADER_ONLY
 #  define FMT_HEADER_ONLY
 #  define FMT_HEADER_ONLY_DEFINED
@@ -25,4 +28,25 @@ namespace sh {
 template<typename T, typename Char = char>
 concept formattable = fmt::is_formattable<T>::value || fmt::has_formatter<T, fmt::buffer_context<Char>>::value;
 
+// Appends to the vector without going through a temporary std::string. Formats
+// into the remaining capacity first, which means short messages never touch
+// the heap when the vector has enough inline storage. Output which does not
+// fit grows the vector geometrically and is formatted a second time.
+template<std::size_t kSize, typename... Args>
+void format_to(vector<char, kSize>& dst, fmt::format_string<Args...> format, Args&&... args) {
+  const auto size = dst.size();
+  dst.resize_for_overwrite(dst.capacity());
+  const auto available = dst.size() - size;
+
+  const auto store = fmt::make_format_args(args...);
+  const auto result = fmt::vformat_to_n(dst.data() + size, available, format, store);
+  if (result.size > available) {
+    dst.reserve(std::max(size + result.size, 2 * dst.capacity()));
+    dst.resize_for_overwrite(size + result.size);
+    fmt::vformat_to(dst.data() + size, format, store);
+  } else {
+    dst.resize_for_overwrite(size + result.size);
+  }
+}
+
 }  // namespace sh
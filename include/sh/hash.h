@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <string_view>
 #include <sh/int.h>
 #include <sh/iterator.h>
 
@@ -58,4 +62,120 @@ auto hash(I first, S last) -> u64 {
   return seed;
 }
 
+struct string_hash {
+  using is_transparent = void;
+
+  auto operator()(std::string_view view) const -> std::size_t {
+    return murmur(view.data(), view.size(), 0);
+  }
+};
+
+constexpr auto fnv1a(std::string_view data, u64 seed = 0xCBF2'9CE4'8422'2325) -> u64 {
+  for (const auto c : data) {
+    seed ^= static_cast<u8>(c);
+    seed *= 0x0000'0100'0000'01B3;
+  }
+  return seed;
+}
+
+// Compile-time perfect hash over a fixed set of keys (hash and displace).
+// Keys are distributed into buckets by a first hash and every bucket gets
+// a displacement seed which maps its keys into free slots without collisions.
+// A lookup costs two hashes and a single key comparison.
+template<std::size_t kSize>
+class perfect_hash {
+public:
+  static constexpr auto npos = static_cast<std::size_t>(-1);
+
+  consteval perfect_hash(const std::array<std::string_view, kSize>& keys)
+    : keys_(keys) {
+    for (std::size_t i = 0; i < kSize; ++i) {
+      for (std::size_t j = i + 1; j < kSize; ++j) {
+        if (keys_[i] == keys_[j]) {
+          throw "duplicate perfect hash key";
+        }
+      }
+    }
+
+    std::array<std::size_t, kSize> order{};
+    std::array<std::size_t, kBuckets> counts{};
+    for (std::size_t i = 0; i < kSize; ++i) {
+      order[i] = i;
+      counts[bucket(keys_[i])]++;
+    }
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+      const auto bucket_a = bucket(keys_[a]);
+      const auto bucket_b = bucket(keys_[b]);
+      if (counts[bucket_a] != counts[bucket_b]) {
+        return counts[bucket_a] > counts[bucket_b];
+      }
+      return bucket_a < bucket_b;
+    });
+
+    slots_.fill(npos);
+    for (std::size_t first = 0; first < kSize;) {
+      const auto current = bucket(keys_[order[first]]);
+      auto last = first;
+      while (last < kSize && bucket(keys_[order[last]]) == current) {
+        last++;
+      }
+
+      for (u64 seed = 1;; ++seed) {
+        std::array<std::size_t, kSize> taken{};
+        auto count = 0u;
+        auto valid = true;
+        for (auto i = first; i < last && valid; ++i) {
+          const auto slot = this->slot(keys_[order[i]], seed);
+          valid = slots_[slot] == npos && std::find(taken.begin(), taken.begin() + count, slot) == taken.begin() + count;
+          taken[count++] = slot;
+        }
+        if (valid) {
+          for (auto i = first; i < last; ++i) {
+            slots_[taken[i - first]] = order[i];
+          }
+          seeds_[current] = seed;
+          break;
+        }
+      }
+      first = last;
+    }
+  }
+
+  [[nodiscard]] constexpr auto find(std::string_view key) const -> std::size_t {
+    if constexpr (kSize == 0) {
+      return npos;
+    } else {
+      const auto index = slots_[slot(key, seeds_[bucket(key)])];
+      return index != npos && keys_[index] == key ? index : npos;
+    }
+  }
+
+  [[nodiscard]] constexpr auto keys() const -> const std::array<std::string_view, kSize>& {
+    return keys_;
+  }
+
+private:
+  static constexpr std::size_t kBuckets = std::bit_ceil(std::max<std::size_t>(kSize, 1));
+  static constexpr std::size_t kSlots = std::bit_ceil(std::max<std::size_t>(kSize + kSize / 2, 1));
+
+  static constexpr auto mix(u64 hash) -> u64 {
+    hash ^= hash >> 33;
+    hash *= 0xFF51'AFD7'ED55'8CCD;
+    hash ^= hash >> 33;
+    return hash;
+  }
+
+  static constexpr auto bucket(std::string_view key) -> std::size_t {
+    return mix(fnv1a(key)) & (kBuckets - 1);
+  }
+
+  static constexpr auto slot(std::string_view key, u64 seed) -> std::size_t {
+    return mix(fnv1a(key, seed)) & (kSlots - 1);
+  }
+
+  std::array<std::string_view, kSize> keys_;
+  std::array<u64, kBuckets> seeds_{};
+  std::array<std::size_t, kSlots> slots_{};
+};
+
 }  // namespace sh
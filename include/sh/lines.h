@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <sh/env.h>
+#include <sh/filesystem.h>
+#include <sh/int.h>
+
+#if SH_SIMD_AVX2
+#  include <immintrin.h>
+#elif SH_SIMD_SSE2
+#  include <emmintrin.h>
+#endif
+
+namespace sh {
+
+namespace {
+
+// Returns the first newline in [begin, end) or end.
+inline auto find_newline(const char* begin, const char* end) -> const char* {
+#if SH_SIMD_AVX2
+  const auto newline = _mm256_set1_epi8('\n');
+  for (; end - begin >= 32; begin += 32) {
+    const auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    if (const auto mask = static_cast<u32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline)))) {
+      return begin + std::countr_zero(mask);
+    }
+  }
+#endif
+#if SH_SIMD_SSE2 || SH_SIMD_AVX2
+  const auto newline16 = _mm_set1_epi8('\n');
+  for (; end - begin >= 16; begin += 16) {
+    const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    if (const auto mask = static_cast<u32>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline16)))) {
+      return begin + std::countr_zero(mask);
+    }
+  }
+  for (; begin != end; ++begin) {
+    if (*begin == '\n') {
+      return begin;
+    }
+  }
+  return end;
+#else
+  const auto found = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+  return found ? found : end;
+#endif
+}
+
+}  // namespace
+
+// Forward range over the lines of a buffer. Lines are separated by \n or
+// \r\n and do not include the separator. A trailing separator does not
+// start another line, like std::getline.
+class lines {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+
+    iterator(const char* begin, const char* end)
+      : next_(begin), end_(end) {
+      advance();
+    }
+
+    auto operator*() const -> const value_type& {
+      return line_;
+    }
+
+    auto operator->() const -> const value_type* {
+      return &line_;
+    }
+
+    auto operator++() -> iterator& {
+      advance();
+      return *this;
+    }
+
+    auto operator++(int) -> iterator {
+      auto copy = *this;
+      advance();
+      return copy;
+    }
+
+    auto operator==(const iterator& other) const -> bool {
+      return line_.data() == other.line_.data();
+    }
+
+    auto operator==(std::default_sentinel_t) const -> bool {
+      return line_.data() == nullptr;
+    }
+
+  private:
+    void advance() {
+      if (next_ == end_) {
+        line_ = {};
+        return;
+      }
+
+      const auto newline = find_newline(next_, end_);
+      auto last = newline;
+      if (newline != end_ && last != next_ && last[-1] == '\r') {
+        last--;
+      }
+      line_ = {next_, static_cast<std::size_t>(last - next_)};
+      next_ = newline == end_ ? end_ : newline + 1;
+    }
+
+    const char* next_ = nullptr;
+    const char* end_ = nullptr;
+    value_type line_;
+  };
+
+  lines() = default;
+
+  explicit lines(std::string_view data)
+    : data_(data) {}
+
+  explicit lines(const filesystem::mapped_file& file)
+    : data_(file.view()) {}
+
+  [[nodiscard]] auto begin() const -> iterator {
+    return {data_.data(), data_.data() + data_.size()};
+  }
+
+  [[nodiscard]] auto end() const -> iterator {
+    return {};
+  }
+
+  [[nodiscard]] auto data() const -> std::string_view {
+    return data_;
+  }
+
+  // Splits the buffer into at most count chunks of similar size. Every
+  // chunk ends after a newline, so no line is shared between chunks.
+  [[nodiscard]] auto split(std::size_t count) const -> std::vector<lines> {
+    std::vector<lines> chunks;
+    count = std::max<std::size_t>(count, 1);
+    chunks.reserve(count);
+
+    const auto end = data_.data() + data_.size();
+    auto begin = data_.data();
+    for (std::size_t i = 1; i < count && begin != end; ++i) {
+      const auto target = data_.data() + data_.size() * i / count;
+      if (target <= begin) {
+        continue;
+      }
+      const auto newline = find_newline(target - 1, end);
+      const auto last = newline == end ? end : newline + 1;
+      chunks.emplace_back(std::string_view(begin, last - begin));
+      begin = last;
+    }
+    if (begin != end) {
+      chunks.emplace_back(std::string_view(begin, end - begin));
+    }
+    return chunks;
+  }
+
+  // Splits the buffer into line-aligned chunks and visits them on a pool of
+  // threads. The visitor receives the chunk index and its lines and is
+  // called concurrently. The first exception is rethrown after all threads
+  // have finished.
+  template<typename Visitor>
+    requires std::invocable<Visitor&, std::size_t, lines>
+  void parallel(Visitor&& visitor, std::size_t threads = 0) const {
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    const auto chunks = split(threads);
+    std::mutex mutex;
+    std::exception_ptr exception;
+
+    const auto work = [&](std::size_t index) {
+      try {
+        visitor(index, chunks[index]);
+      } catch (...) {
+        std::lock_guard lock(mutex);
+        if (!exception) {
+          exception = std::current_exception();
+        }
+      }
+    };
+
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < chunks.size(); ++i) {
+      pool.emplace_back(work, i);
+    }
+    if (!chunks.empty()) {
+      work(0);
+    }
+    for (auto& thread : pool) {
+      thread.join();
+    }
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+private:
+  std::string_view data_;
+};
+
+}  // namespace sh
@@ -0,0 +1,411 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <sh/error.h>
+#include <sh/filesystem.h>
+#include <sh/int.h>
+
+namespace sh {
+
+// Vector of trivially copyable elements stored in a memory-mapped file. The
+// file starts with a header holding the element count, element size and a
+// version, the elements follow. Growing extends the file and remaps it, so
+// pointers and iterators are invalidated like in sh::vector.
+template<typename T>
+  requires std::is_trivially_copyable_v<T>
+class mapped_vector {
+public:
+  using value_type             = T;
+  using size_type              = std::size_t;
+  using difference_type        = std::make_signed_t<size_type>;
+  using reference              = value_type&;
+  using const_reference        = const value_type&;
+  using pointer                = value_type*;
+  using const_pointer          = const value_type*;
+  using iterator               = pointer;
+  using const_iterator         = const_pointer;
+  using reverse_iterator       = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  static constexpr u32 kVersion = 1;
+
+  mapped_vector() = default;
+  mapped_vector(const mapped_vector&) = delete;
+
+  mapped_vector(mapped_vector&& other) noexcept {
+    *this = std::move(other);
+  }
+
+  ~mapped_vector() {
+    close();
+  }
+
+  auto operator=(const mapped_vector&) -> mapped_vector& = delete;
+
+  auto operator=(mapped_vector&& other) noexcept -> mapped_vector& {
+    if (this != &other) [[likely]] {
+      close();
+      std::swap(handle_, other.handle_);
+      std::swap(map_, other.map_);
+      std::swap(bytes_, other.bytes_);
+    }
+    return *this;
+  }
+
+  // Opens or creates the file. Existing files must have been written with
+  // the same element size and version.
+  auto open(const filesystem::path& file) -> filesystem::status {
+    using filesystem::status;
+
+    close();
+#if SH_OS_WINDOWS
+    handle_ = CreateFileW(file.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle_ == INVALID_HANDLE_VALUE) {
+      return status::bad_file;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(handle_, &file_size)) {
+      close();
+      return status::bad_stream;
+    }
+    const auto size = static_cast<std::size_t>(file_size.QuadPart);
+#else
+    handle_ = ::open(file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (handle_ == -1) {
+      return status::bad_file;
+    }
+
+    struct stat stat;
+    if (fstat(handle_, &stat) == -1) {
+      close();
+      return status::bad_stream;
+    }
+    const auto size = static_cast<std::size_t>(stat.st_size);
+#endif
+
+    if (size == 0) {
+      if (!remap(kHeaderSize)) {
+        close();
+        return status::bad_map;
+      }
+      *header() = {kMagic, kVersion, sizeof(T), 0};
+      return status::ok;
+    }
+
+    if (size < kHeaderSize || (size - kHeaderSize) % sizeof(T) != 0) {
+      close();
+      return status::bad_size;
+    }
+    if (!remap(size)) {
+      close();
+      return status::bad_map;
+    }
+
+    const auto& header = *this->header();
+    if (header.magic != kMagic || header.version != kVersion || header.type_size != sizeof(T) || header.size > capacity()) {
+      close();
+      return status::bad_size;
+    }
+    return status::ok;
+  }
+
+  void close() {
+    unmap();
+#if SH_OS_WINDOWS
+    if (handle_ != INVALID_HANDLE_VALUE) {
+      CloseHandle(handle_);
+      handle_ = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (handle_ != -1) {
+      ::close(handle_);
+      handle_ = -1;
+    }
+#endif
+  }
+
+  // Writes dirty pages back to the file, waits for completion unless async.
+  auto flush(bool async = false) -> filesystem::status {
+    if (!map_) {
+      return filesystem::status::ok;
+    }
+#if SH_OS_WINDOWS
+    if (!FlushViewOfFile(map_, 0) || (!async && !FlushFileBuffers(handle_))) {
+      return filesystem::status::bad_stream;
+    }
+#else
+    if (msync(map_, bytes_, async ? MS_ASYNC : MS_SYNC) == -1) {
+      return filesystem::status::bad_stream;
+    }
+#endif
+    return filesystem::status::ok;
+  }
+
+  [[nodiscard]] auto is_open() const -> bool {
+    return map_ != nullptr;
+  }
+
+  auto operator[](size_type index) -> reference {
+    assert(index < size());
+    return data()[index];
+  }
+
+  auto operator[](size_type index) const -> const_reference {
+    assert(index < size());
+    return data()[index];
+  }
+
+  auto front() -> reference {
+    return (*this)[0];
+  }
+
+  auto front() const -> const_reference {
+    return (*this)[0];
+  }
+
+  auto back() -> reference {
+    return (*this)[size() - 1];
+  }
+
+  auto back() const -> const_reference {
+    return (*this)[size() - 1];
+  }
+
+  auto data() -> pointer {
+    return map_ ? reinterpret_cast<pointer>(map_ + kHeaderSize) : nullptr;
+  }
+
+  auto data() const -> const_pointer {
+    return map_ ? reinterpret_cast<const_pointer>(map_ + kHeaderSize) : nullptr;
+  }
+
+  auto begin() -> iterator {
+    return data();
+  }
+
+  auto begin() const -> const_iterator {
+    return data();
+  }
+
+  auto cbegin() const -> const_iterator {
+    return begin();
+  }
+
+  auto end() -> iterator {
+    return data() + size();
+  }
+
+  auto end() const -> const_iterator {
+    return data() + size();
+  }
+
+  auto cend() const -> const_iterator {
+    return end();
+  }
+
+  auto rbegin() -> reverse_iterator {
+    return reverse_iterator(end());
+  }
+
+  auto rbegin() const -> const_reverse_iterator {
+    return const_reverse_iterator(end());
+  }
+
+  auto rend() -> reverse_iterator {
+    return reverse_iterator(begin());
+  }
+
+  auto rend() const -> const_reverse_iterator {
+    return const_reverse_iterator(begin());
+  }
+
+  auto empty() const -> bool {
+    return size() == 0;
+  }
+
+  auto size() const -> size_type {
+    return map_ ? static_cast<size_type>(header()->size) : 0;
+  }
+
+  auto capacity() const -> size_type {
+    return map_ ? (bytes_ - kHeaderSize) / sizeof(T) : 0;
+  }
+
+  auto max_size() const -> size_type {
+    return (std::numeric_limits<size_type>::max() - kHeaderSize) / sizeof(T);
+  }
+
+  void reserve(size_type capacity) {
+    if (capacity > this->capacity()) {
+      grow(capacity);
+    }
+  }
+
+  // Shrinks the file to the current size.
+  void shrink_to_fit() {
+    if (map_ && capacity() > size()) {
+      grow(size());
+    }
+  }
+
+  void clear() {
+    if (map_) {
+      header()->size = 0;
+    }
+  }
+
+  void resize(size_type size) {
+    resize(size, value_type{});
+  }
+
+  void resize(size_type size, const value_type& value) {
+    reserve(size);
+    if (size > this->size()) {
+      std::fill(end(), data() + size, value);
+    }
+    header()->size = size;
+  }
+
+  template<typename... Args>
+    requires std::constructible_from<value_type, Args...>
+  auto emplace_back(Args&&... args) -> reference {
+    if (size() == capacity()) [[unlikely]] {
+      grow(std::max<size_type>(2 * capacity(), kMinCapacity));
+    }
+    return *std::construct_at(data() + header()->size++, std::forward<Args>(args)...);
+  }
+
+  void push_back(const value_type& value) {
+    static_cast<void>(emplace_back(value));
+  }
+
+  void pop_back() {
+    assert(!empty());
+    header()->size--;
+  }
+
+  void pop_back(std::size_t count) {
+    assert(count <= size());
+    header()->size -= count;
+  }
+
+  auto pop_back_value() -> value_type {
+    assert(!empty());
+    return data()[--header()->size];
+  }
+
+private:
+  static constexpr u32 kMagic = 0x5643'4853;
+  static constexpr std::size_t kHeaderSize = std::max<std::size_t>(64, alignof(T));
+  static constexpr std::size_t kMinCapacity = std::max<std::size_t>(1, 4096 / sizeof(T));
+
+  struct header_t {
+    u32 magic;
+    u32 version;
+    u64 type_size;
+    u64 size;
+  };
+
+  auto header() -> header_t* {
+    return reinterpret_cast<header_t*>(map_);
+  }
+
+  auto header() const -> const header_t* {
+    return reinterpret_cast<const header_t*>(map_);
+  }
+
+  void grow(size_type capacity) {
+    if (capacity > max_size() || !remap(kHeaderSize + capacity * sizeof(T))) {
+      throw error("cannot grow mapped_vector to {} elements", capacity);
+    }
+  }
+
+  // Resizes the file and maps it with the new size. The new region is
+  // mapped before the old one is released, so a failure keeps the current
+  // mapping. Only shrinking on Windows has to unmap first, because views
+  // prevent truncating the file there.
+  auto remap(std::size_t bytes) -> bool {
+#if SH_OS_WINDOWS
+    if (map_ && bytes < bytes_) {
+      unmap();
+    }
+    if (!map_) {
+      LARGE_INTEGER size;
+      size.QuadPart = static_cast<LONGLONG>(bytes);
+      if (!SetFilePointerEx(handle_, size, NULL, FILE_BEGIN) || !SetEndOfFile(handle_)) {
+        return false;
+      }
+    }
+
+    // A mapping larger than the file extends it.
+    const auto mapping = CreateFileMappingW(handle_, NULL, PAGE_READWRITE, static_cast<DWORD>(u64(bytes) >> 32), static_cast<DWORD>(bytes), NULL);
+    if (!mapping) {
+      return false;
+    }
+    const auto data = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data) {
+      return false;
+    }
+    unmap();
+#else
+    struct stat stat;
+    if (fstat(handle_, &stat) == -1) {
+      return false;
+    }
+    const auto size = static_cast<std::size_t>(stat.st_size);
+    if (bytes > size && ftruncate(handle_, static_cast<off_t>(bytes)) == -1) {
+      return false;
+    }
+#  if SH_OS_LINUX
+    const auto data = map_
+      ? mremap(map_, bytes_, bytes, MREMAP_MAYMOVE)
+      : mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, handle_, 0);
+#  else
+    const auto data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, handle_, 0);
+#  endif
+    if (data == MAP_FAILED) {
+      return false;
+    }
+#  if !SH_OS_LINUX
+    unmap();
+#  endif
+#endif
+    map_ = static_cast<char*>(data);
+    bytes_ = bytes;
+#if !SH_OS_WINDOWS
+    if (bytes < size && ftruncate(handle_, static_cast<off_t>(bytes)) == -1) {
+      return false;
+    }
+#endif
+    return true;
+  }
+
+  void unmap() {
+    if (map_) {
+#if SH_OS_WINDOWS
+      UnmapViewOfFile(map_);
+#else
+      munmap(map_, bytes_);
+#endif
+    }
+    map_ = nullptr;
+    bytes_ = 0;
+  }
+
+#if SH_OS_WINDOWS
+  HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+  int handle_ = -1;
+#endif
+  char* map_ = nullptr;
+  std::size_t bytes_ = 0;
+};
+
+}  // namespace sh
@@ -1,12 +1,16 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <charconv>
 #include <concepts>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 #include <sh/deps/fast_float/include/fast_float/fast_float.h>
 #include <sh/int.h>
+#include <sh/vector.h>
 
 namespace std {
 
@@ -26,7 +30,7 @@ struct number_parser {
     const auto beg = data.data();
     const auto end = data.data() + data.size();
     const auto& [ptr, ec] = std::from_chars(beg, end, value, std::forward<Args>(args)...);
-    if (ec == std::errc::result_out_of_range || ptr != end) {
+    if (ec != std::errc{} || ptr != end) {
       return std::nullopt;
     }
     return value;
@@ -118,9 +122,96 @@ struct parser<std::string_view> {
 template<typename T>
 concept parsable = std::destructible<parser<T>>;
 
+namespace detail {
+
+inline auto trim(std::string_view view) -> std::string_view {
+  const auto pos = view.find_first_not_of(' ');
+  if (std::string_view::npos == pos) {
+    return {};
+  }
+  const auto end = view.find_last_not_of(' ');
+  return view.substr(pos, end - pos + 1);
+}
+
+template<typename Callback>
+auto split(std::string_view data, char separator, Callback&& callback) -> bool {
+  while (true) {
+    const auto pos = data.find(separator);
+    if (!callback(trim(data.substr(0, pos)))) {
+      return false;
+    }
+    if (pos == std::string_view::npos) {
+      return true;
+    }
+    data.remove_prefix(pos + 1);
+  }
+}
+
+template<typename Container, parsable T>
+struct list_parser {
+  auto parse(std::string_view data, char separator = ',') -> std::optional<Container> {
+    Container values;
+    if (trim(data).empty()) {
+      return values;
+    }
+
+    values.reserve(std::count(data.begin(), data.end(), separator) + 1);
+    parser<T> element;
+    const auto valid = split(data, separator, [&](std::string_view item) {
+      if (auto value = element.parse(item)) {
+        values.push_back(std::move(*value));
+        return true;
+      }
+      return false;
+    });
+    if (!valid) {
+      return std::nullopt;
+    }
+    return values;
+  }
+};
+
+}  // namespace detail
+
+template<parsable T, std::size_t kSize>
+struct parser<vector<T, kSize>> : detail::list_parser<vector<T, kSize>, T> {};
+
 template<parsable T>
-auto parse(std::string_view data) -> std::optional<T> {
-  return parser<T>{}.parse(data);
+struct parser<std::vector<T>> : detail::list_parser<std::vector<T>, T> {};
+
+template<parsable T, std::size_t kSize>
+struct parser<std::array<T, kSize>> {
+  auto parse(std::string_view data, char separator = ',') -> std::optional<std::array<T, kSize>> {
+    std::array<T, kSize> values{};
+    if (detail::trim(data).empty()) {
+      if (kSize == 0) {
+        return values;
+      }
+      return std::nullopt;
+    }
+
+    std::size_t index = 0;
+    parser<T> element;
+    const auto valid = detail::split(data, separator, [&](std::string_view item) {
+      if (index == kSize) {
+        return false;
+      }
+      if (auto value = element.parse(item)) {
+        values[index++] = std::move(*value);
+        return true;
+      }
+      return false;
+    });
+    if (!valid || index != kSize) {
+      return std::nullopt;
+    }
+    return values;
+  }
+};
+
+template<parsable T, typename... Args>
+auto parse(std::string_view data, Args&&... args) -> std::optional<T> {
+  return parser<T>{}.parse(data, std::forward<Args>(args)...);
 }
 
 }  // namespace sh
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <tuple>
+#include <sh/clap.h>
+#include <sh/hash.h>
+
+namespace sh {
+
+template<std::size_t kSize>
+struct fixed_string {
+  constexpr fixed_string(const char (&data)[kSize]) {
+    std::copy_n(data, kSize, this->data);
+  }
+
+  constexpr operator std::string_view() const {
+    return {data, kSize - 1};
+  }
+
+  char data[kSize]{};
+};
+
+// Like in sh::clap, arguments of type sh::vector<T> collect every
+// occurrence and arguments of type sh::counter count them.
+template<fixed_string kName, argument_type T, auto... kDefault>
+  requires (sizeof...(kDefault) <= 1)
+struct arg {
+  using type = T;
+  using value_type = value_type_t<T>;
+  using storage_type = std::conditional_t<is_accumulating_v<T>, T, value_type>;
+
+  static constexpr std::string_view name = kName;
+  static constexpr bool positional = !name.starts_with('-');
+  static constexpr bool counting = std::same_as<T, counter>;
+  static constexpr bool boolean = std::same_as<value_type, bool> || counting;
+  static constexpr bool optional = specialization<T, std::optional> || counting || is_accumulating_v<T> || sizeof...(kDefault) == 1;
+
+  static auto fallback() -> T {
+    if constexpr (sizeof...(kDefault) == 1) {
+      return T{kDefault...};
+    } else if constexpr (specialization<T, std::optional>) {
+      return std::nullopt;
+    } else if constexpr (counting || is_accumulating_v<T>) {
+      return T{};
+    } else {
+      throw error("empty argument: {}", name);
+    }
+  }
+};
+
+// Argument parser with a schema fixed at compile time. Names are resolved
+// through a perfect hash, values are stored in a tuple and accessed without
+// virtual dispatch. Unknown names in get<>() fail to compile.
+template<typename... Args>
+class static_clap {
+public:
+  static constexpr auto kSize = sizeof...(Args);
+
+  void parse(int argc, const char* const* argv) {
+    reserve_ = static_cast<std::size_t>(std::max(argc, 0));
+    auto index = 1;
+    auto pos_index = std::size_t{0};
+    auto pos_force = false;
+    while (index < argc) {
+      const auto& data = trim(argv[index++]);
+      if (data == "--" && !pos_force) {
+        pos_force = true;
+        continue;
+      }
+
+      const auto [key, value] = split(data, '=');
+      const auto argument = kHash.find(trim(key));
+      if (argument != kHash.npos && !kPositional[argument] && !pos_force) {
+        if (value) {
+          kParsers[argument](*this, value);
+        } else if (index < argc && !kBoolean[argument]) {
+          kParsers[argument](*this, argv[index++]);
+        } else {
+          kParsers[argument](*this, std::nullopt);
+        }
+      } else if (!pos_force && count(data)) {
+        continue;
+      } else {
+        if (pos_index < kPositionals.size()) {
+          kParsers[kPositionals[pos_index++]](*this, data);
+        } else {
+          unmatched.emplace_back(data);
+        }
+      }
+    }
+
+    validate(std::index_sequence_for<Args...>{});
+  }
+
+  template<fixed_string kName>
+  auto get() const {
+    constexpr auto kIndex = kHash.find(kName);
+    static_assert(kIndex != kHash.npos, "unknown argument");
+
+    using argument = std::tuple_element_t<kIndex, std::tuple<Args...>>;
+    using type = typename argument::type;
+
+    if (const auto& value = std::get<kIndex>(values_)) {
+      if constexpr (is_accumulating_v<type>) {
+        return *value;
+      } else {
+        return type{*value};
+      }
+    }
+    return argument::fallback();
+  }
+
+  vector<std::string_view, 8> unmatched;
+
+private:
+  using parser = void(*)(static_clap&, std::optional<std::string_view>);
+
+  static constexpr auto kHash = perfect_hash<kSize>({Args::name...});
+  static constexpr std::array<bool, kSize> kPositional = {Args::positional...};
+  static constexpr std::array<bool, kSize> kBoolean = {Args::boolean...};
+  static constexpr std::array<bool, kSize> kCounting = {Args::counting...};
+
+  static constexpr auto kPositionals = [] {
+    std::array<std::size_t, (std::size_t(Args::positional) + ... + 0)> positionals{};
+    for (std::size_t i = 0, j = 0; i < kSize; ++i) {
+      if (kPositional[i]) {
+        positionals[j++] = i;
+      }
+    }
+    return positionals;
+  }();
+
+  template<std::size_t kIndex>
+  static void parse(static_clap& self, std::optional<std::string_view> data) {
+    using argument = std::tuple_element_t<kIndex, std::tuple<Args...>>;
+    using value_type = typename argument::value_type;
+
+    auto& slot = std::get<kIndex>(self.values_);
+    if (data) {
+      const auto& view = trim(*data);
+      if (auto value = sh::parse<value_type>(view)) {
+        if constexpr (is_accumulating_v<typename argument::type>) {
+          if (!slot) {
+            slot.emplace().reserve(self.reserve_);
+          }
+          slot->push_back(std::move(*value));
+        } else {
+          slot = std::move(*value);
+        }
+      } else {
+        throw error("invalid argument data: {}", view);
+      }
+    } else {
+      if constexpr (std::same_as<value_type, bool>) {
+        slot = true;
+      } else if constexpr (argument::counting) {
+        slot = slot ? *slot + 1 : 1;
+      } else {
+        throw error("missing argument data: {}", argument::name);
+      }
+    }
+  }
+
+  static constexpr auto kParsers = []<std::size_t... kIs>(std::index_sequence<kIs...>) {
+    return std::array<parser, kSize>{&parse<kIs>...};
+  }(std::index_sequence_for<Args...>{});
+
+  // Counts bundled short flags like -vvv.
+  auto count(std::string_view data) -> bool {
+    if (data.size() < 3 || data[0] != '-' || data[1] == '-') {
+      return false;
+    }
+    if (data.find_first_not_of(data[1], 2) != std::string_view::npos) {
+      return false;
+    }
+
+    const auto argument = kHash.find(data.substr(0, 2));
+    if (argument == kHash.npos || !kCounting[argument]) {
+      return false;
+    }
+    for (std::size_t i = 1; i < data.size(); ++i) {
+      kParsers[argument](*this, std::nullopt);
+    }
+    return true;
+  }
+
+  template<std::size_t... kIs>
+  void validate(std::index_sequence<kIs...>) const {
+    const auto check = [](const auto& value, auto argument) {
+      using type = decltype(argument);
+      if (!(type::optional || value)) {
+        throw error("missing required argument: {}", type::name);
+      }
+    };
+    (check(std::get<kIs>(values_), Args{}), ...);
+  }
+
+  std::tuple<std::optional<typename Args::storage_type>...> values_;
+  std::size_t reserve_ = 0;
+};
+
+}  // namespace sh
@@ -288,6 +288,21 @@ class vector_base {
     do_resize(size);
   }
 
+  // Default-initializes new elements, which leaves trivial types
+  // uninitialized. Use when the elements are overwritten afterwards.
+  void resize_for_overwrite(size_type size)
+      requires std::default_initializable<value_type> {
+    if (size > this->size()) {
+      if (size > capacity()) {
+        reallocate(size);
+      }
+      std::uninitialized_default_construct(end(), begin() + size);
+    } else if (size < this->size()) {
+      std::destroy(begin() + size, end());
+    }
+    head_ = begin() + size;
+  }
+
   template<typename... Args>
     requires std::constructible_from<value_type, Args...>
   auto emplace_back(Args&&... args) -> reference {
@@ -534,6 +549,7 @@ class vector : private detail::vector_base<T, vector<T, kSize>> {
   using base::insert;
   using base::erase;
   using base::resize;
+  using base::resize_for_overwrite;
   using base::emplace_back;
   using base::push_back;
   using base::pop_back;
@@ -692,6 +708,7 @@ class vector<T, 0> : private detail::vector_base<T, vector<T>> {
   using base::insert;
   using base::erase;
   using base::resize;
+  using base::resize_for_overwrite;
   using base::emplace_back;
   using base::push_back;
   using base::pop_back;
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include "allocations.h"
+
+std::atomic<std::size_t> allocations = 0;
+
+namespace {
+
+auto allocate(std::size_t size) -> void* {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(std::max<std::size_t>(size, 1));
+}
+
+auto allocate(std::size_t size, std::align_val_t alignment) -> void* {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  const auto align = static_cast<std::size_t>(alignment);
+  size = (std::max<std::size_t>(size, 1) + align - 1) / align * align;
+#ifdef _MSC_VER
+  return _aligned_malloc(size, align);
+#else
+  return std::aligned_alloc(align, size);
+#endif
+}
+
+void deallocate(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+void deallocate(void* pointer, std::align_val_t) noexcept {
+#ifdef _MSC_VER
+  _aligned_free(pointer);
+#else
+  std::free(pointer);
+#endif
+}
+
+template<typename... Args>
+auto checked(Args... args) -> void* {
+  if (const auto pointer = allocate(args...)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+}  // namespace
+
+auto operator new(std::size_t size) -> void* {
+  return checked(size);
+}
+
+auto operator new[](std::size_t size) -> void* {
+  return checked(size);
+}
+
+auto operator new(std::size_t size, std::align_val_t alignment) -> void* {
+  return checked(size, alignment);
+}
+
+auto operator new[](std::size_t size, std::align_val_t alignment) -> void* {
+  return checked(size, alignment);
+}
+
+auto operator new(std::size_t size, const std::nothrow_t&) noexcept -> void* {
+  return allocate(size);
+}
+
+auto operator new[](std::size_t size, const std::nothrow_t&) noexcept -> void* {
+  return allocate(size);
+}
+
+auto operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept -> void* {
+  return allocate(size, alignment);
+}
+
+auto operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept -> void* {
+  return allocate(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept {
+  deallocate(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+  deallocate(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+  deallocate(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+  deallocate(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t alignment) noexcept {
+  deallocate(pointer, alignment);
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment) noexcept {
+  deallocate(pointer, alignment);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t alignment) noexcept {
+  deallocate(pointer, alignment);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t alignment) noexcept {
+  deallocate(pointer, alignment);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+  deallocate(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+  deallocate(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  deallocate(pointer, alignment);
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  deallocate(pointer, alignment);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Counts calls to the global operator new, which is replaced in
+// allocations.cpp. Tests allocate from several threads, so the counter is
+// atomic.
+extern std::atomic<std::size_t> allocations;
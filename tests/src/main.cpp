@@ -1,10 +1,18 @@
+//#include "tests/archive.h"
 //#include "tests/array.h"
 //#include "tests/clap.h"
+//#include "tests/config.h"
+//#include "tests/csv.h"
+//#include "tests/enum.h"
 //#include "tests/filesystem.h"
+//#include "tests/fmt.h"
 //#include "tests/hash.h"
+//#include "tests/lines.h"
+//#include "tests/mapped_vector.h"
 //#include "tests/parse.h"
 //#include "tests/ranges.h"
 #include "tests/stack.h"
+//#include "tests/static_clap.h"
 //#include "tests/utility.h"
 //#include "tests/vector.h"
 
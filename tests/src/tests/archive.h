@@ -0,0 +1,145 @@
+#pragma once
+
+#include <sh/archive.h>
+
+#include "ut.h"
+
+namespace tests_archive {
+
+namespace fs = sh::filesystem;
+
+struct point {
+  float x;
+  float y;
+};
+
+struct shape {
+  std::string name;
+  std::vector<point> points;
+};
+
+}  // namespace tests_archive
+
+template<>
+struct sh::archive::serializer<tests_archive::shape> {
+  static void write(sh::archive::writer& dst, const tests_archive::shape& value) {
+    dst.write(value.name);
+    dst.write(value.points);
+  }
+
+  static auto read(sh::archive::reader& src) -> tests_archive::shape {
+    auto name = src.read<std::string>();
+    auto points = src.read<std::vector<tests_archive::point>>();
+    return {std::move(name), std::move(points)};
+  }
+};
+
+namespace tests_archive {
+
+inline suite _ = [] {
+  "archive round trip"_test = [] {
+    sh::archive::writer writer;
+    writer.write(sh::u8(7));
+    writer.write(sh::u64(42));
+    writer.write(std::string_view("text"));
+    writer.write(sh::vector<int>{1, 2, 3});
+    writer.write(std::array<sh::u16, 2>{4, 5});
+    writer.write(std::vector<std::string>{"a", "bc"});
+    writer.write(std::vector<shape>{{"line", {{0, 0}, {1, 1}}}});
+    expect(writer.save("fs/archive.bin") == fs::status::ok);
+
+    sh::archive::reader reader;
+    expect(reader.open("fs/archive.bin") == fs::status::ok);
+    expect(eq(reader.read<sh::u8>(), 7));
+    expect(eq(reader.read<sh::u64>(), 42));
+    expect(eq(reader.read<std::string_view>(), std::string_view("text")));
+
+    const auto ints = reader.read<std::span<const int>>();
+    expect(eq(ints.size(), 3));
+    expect(eq(ints[2], 3));
+
+    const auto array = reader.read<std::array<sh::u16, 2>>();
+    expect(eq(array[1], 5));
+    expect(reader.read<std::vector<std::string>>() == std::vector<std::string>{"a", "bc"});
+
+    const auto shapes = reader.read<std::vector<shape>>();
+    expect(eq(shapes.size(), 1));
+    expect(eq(shapes[0].name, std::string("line")));
+    expect(eq(shapes[0].points[1].y, 1.0f));
+    expect(eq(reader.remaining(), 0));
+    expect(throws([&] { reader.read<sh::u8>(); }));
+  };
+
+  "archive append"_test = [] {
+    sh::archive::writer writer;
+    std::size_t reallocations = 0;
+    for (sh::u32 i = 0; i < 10000; ++i) {
+      const auto data = writer.data().data();
+      writer.write(i);
+      reallocations += writer.data().data() != data;
+    }
+    expect(reallocations <= 20);
+
+    sh::archive::reader reader;
+    expect(reader.open(writer.data()) == fs::status::ok);
+    for (sh::u32 i = 0; i < 10000; ++i) {
+      expect(eq(reader.read<sh::u32>(), i));
+    }
+  };
+
+  "archive reopen missing"_test = [] {
+    sh::archive::writer writer;
+    writer.write(sh::u64(42));
+    expect(writer.save("fs/archive_reopen.bin") == fs::status::ok);
+
+    sh::archive::reader reader;
+    expect(reader.open("fs/archive_reopen.bin") == fs::status::ok);
+    expect(reader.open("fs/archive_missing.bin") != fs::status::ok);
+    expect(eq(reader.read<sh::u64>(), 42));
+  };
+
+  "archive offsets"_test = [] {
+    sh::archive::writer writer;
+    std::vector<sh::u64> offsets;
+    for (const auto name : {"a", "bc", "def"}) {
+      offsets.push_back(writer.offset());
+      writer.write(std::string_view(name));
+      writer.write(sh::vector<sh::u16>{1, 2, 3});
+    }
+    const auto table = writer.offset();
+    writer.write(offsets);
+    writer.write(table);
+    expect(writer.save("fs/archive_offsets.bin") == fs::status::ok);
+
+    sh::archive::reader reader;
+    expect(reader.open("fs/archive_offsets.bin") == fs::status::ok);
+    reader.seek(writer.data().size() - sizeof(sh::u64));
+    reader.seek(reader.read<sh::u64>());
+    const auto index = reader.read<std::span<const sh::u64>>();
+    expect(eq(index.size(), 3));
+
+    reader.seek(index[2]);
+    expect(eq(reader.read<std::string_view>(), std::string_view("def")));
+    expect(eq(reader.view<sh::u16>()[2], 3));
+    reader.seek(index[1]);
+    expect(eq(reader.read<std::string_view>(), std::string_view("bc")));
+
+    expect(throws([&] { reader.seek(0); }));
+    expect(throws([&] { reader.seek(writer.data().size() + 1); }));
+  };
+
+  "archive bounds"_test = [] {
+    sh::archive::writer writer;
+    writer.write(sh::u64(1'000'000));
+    writer.write(sh::u8(0));
+
+    sh::archive::reader reader;
+    expect(reader.open(writer.data()) == fs::status::ok);
+    expect(throws([&] { reader.view<sh::u32>(); }));
+
+    const sh::u8 junk[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    expect(reader.open(junk) == fs::status::bad_size);
+  };
+};
+
+}  // namespace tests_archive
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <fstream>
+
 #include <sh/clap.h>
+#include <sh/filesystem.h>
 
+#include "allocations.h"
 #include "ut.h"
 
 namespace tests_clap {
@@ -144,6 +148,283 @@ inline suite _ = [] {
     expect(eq(a, 1));
     expect(eq(b, 1));
   };
+
+  "clap parse without allocations"_test = [] {
+    const char* argv[] = {"program.exe", "-a", "1", "--bee=2", "-c", "3", "4", "five", "--", "-x"};
+    int c = 0;
+    sh::clap parser("program");
+    parser.add<int>("-a");
+    parser.add<int>("-b", "--bee");
+    parser.add<int>("-c") << &c << [&](int value) { c += value; };
+    parser.add<std::optional<bool>>("-d");
+    parser.add<int>("e");
+    parser.add<std::string_view>("f");
+
+    const auto before = allocations.load();
+    parser.parse(std::size(argv), argv);
+    expect(eq(allocations.load(), before));
+    expect(eq(parser.get<int>("--bee"), 2));
+    expect(eq(c, 6));
+    expect(eq(parser.unmatched[0], std::string_view("-x")));
+  };
+
+  "clap many arguments"_test = [] {
+    std::vector<std::string> names;
+    for (int i = 0; i < 500; ++i) {
+      names.push_back(fmt::format("--option{}", i));
+    }
+
+    std::vector<std::string> data;
+    data.push_back("program.exe");
+    for (int i = 0; i < 5000; ++i) {
+      data.push_back(names[(7 * i) % names.size()]);
+      data.push_back(std::to_string(i));
+    }
+
+    std::vector<const char*> argv;
+    for (const auto& arg : data) {
+      argv.push_back(arg.c_str());
+    }
+
+    sh::clap parser("program");
+    for (const auto& name : names) {
+      parser.add<int>(name) << -1;
+    }
+    parser.parse(argv.size(), argv.data());
+    expect(eq(parser.get<int>("--option0"), 4500));
+    expect(eq(parser.get<int>("--option7"), 4501));
+  };
+
+  "clap list"_test = [] {
+    const char* argv[] = {"program.exe", "--ids", "1,2,3", "--size=4, 5"};
+    sh::clap parser("program");
+    parser.add<std::vector<int>>("--ids");
+    parser.add<std::array<int, 2>>("--size");
+    parser.parse(std::size(argv), argv);
+    expect(eq(parser.get<std::vector<int>>("--ids"), std::vector<int>{1, 2, 3}));
+    expect(parser.get<std::array<int, 2>>("--size") == std::array<int, 2>{4, 5});
+  };
+
+  "clap response files"_test = [] {
+    namespace fs = sh::filesystem;
+    expect(fs::write("fs/args.rsp", std::string_view("-a 1\n--name \"x y\" 'a\\b' @fs/nested.rsp")) == fs::status::ok);
+    expect(fs::write("fs/nested.rsp", std::string_view("-c=\"\\\"q\\\"\" d\\ e")) == fs::status::ok);
+
+    const char* argv[] = {"program.exe", "@fs/args.rsp", "-b", "2"};
+    sh::clap parser("program");
+    parser.add_response_files();
+    parser.add<int>("-a");
+    parser.add<int>("-b");
+    parser.add<std::string_view>("-c");
+    parser.add<std::string_view>("--name");
+    parser.add<std::string_view>("f");
+    parser.add<std::string_view>("g");
+    parser.parse(std::size(argv), argv);
+    expect(eq(parser.get<int>("-a"), 1));
+    expect(eq(parser.get<int>("-b"), 2));
+    expect(eq(parser.get<std::string_view>("--name"), "x y"sv));
+    expect(eq(parser.get<std::string_view>("f"), "a\\b"sv));
+    expect(eq(parser.get<std::string_view>("-c"), "\"q\""sv));
+    expect(eq(parser.get<std::string_view>("g"), "d e"sv));
+  };
+
+  "clap response files errors"_test = [] {
+    namespace fs = sh::filesystem;
+    expect(fs::write("fs/loop.rsp", std::string_view("@fs/loop.rsp")) == fs::status::ok);
+
+    const char* missing[] = {"program.exe", "@fs/missing.rsp"};
+    const char* loop[] = {"program.exe", "@fs/loop.rsp"};
+    sh::clap parser("program");
+    parser.add_response_files(4);
+    expect(throws([&] { parser.parse(std::size(missing), missing); }));
+    expect(throws([&] { parser.parse(std::size(loop), loop); }));
+
+    sh::clap disabled("program");
+    disabled.parse(std::size(loop), loop);
+    expect(eq(disabled.unmatched[0], "@fs/loop.rsp"sv));
+  };
+
+  "clap response files without arguments"_test = [] {
+    const char* argv[] = {nullptr};
+    sh::clap parser("program");
+    parser.add_response_files();
+    parser.add<int>("-a") << 1;
+    parser.parse(0, argv);
+    expect(eq(parser.get<int>("-a"), 1));
+    expect(parser.unmatched.empty());
+  };
+
+  "clap lazy"_test = [] {
+    const char* argv[] = {"program.exe", "--ids", "1,2,3", "--bad", "x", "-c", "3"};
+    int c = 0;
+    sh::clap parser("program");
+    parser.add<std::vector<int>>("--ids") << sh::lazy;
+    parser.add<int>("--bad") << sh::lazy;
+    parser.add<int>("-c") << sh::lazy << &c;
+    parser.add<int>("-d") << sh::lazy << 4;
+    parser.parse(std::size(argv), argv);
+    expect(eq(c, 3));
+    expect(eq(parser.get<std::vector<int>>("--ids"), std::vector<int>{1, 2, 3}));
+    expect(eq(parser.get<int>("-d"), 4));
+    expect(throws([&] { parser.get<int>("--bad"); }));
+    expect(throws([&] { parser.resolve(); }));
+
+    const char* missing[] = {"program.exe", "--ids", "1"};
+    sh::clap other("program");
+    other.add<std::vector<int>>("--ids") << sh::lazy;
+    other.add<int>("--bad") << sh::lazy;
+    expect(throws([&] { other.parse(std::size(missing), missing); }));
+  };
+
+  "clap commands"_test = [] {
+    const char* argv[] = {"program.exe", "-v", "build", "-j", "4", "target"};
+    auto selected = 0;
+    sh::clap parser("program");
+    parser.add_help();
+    parser.add<bool>("-v");
+    parser.add_command("build", [&](sh::clap& command) {
+      selected++;
+      command.add<int>("-j");
+      command.add<std::string_view>("target");
+    }, sh::desc("build a target"));
+    parser.add_command("clean", [&](sh::clap&) {
+      selected += 10;
+    });
+    parser.parse(std::size(argv), argv);
+    expect(eq(selected, 1));
+    expect(eq(parser.get<bool>("-v"), true));
+    expect(eq(parser.command_name(), "build"sv));
+    expect(eq(parser.command()->get<int>("-j"), 4));
+    expect(eq(parser.command()->get<std::string_view>("target"), "target"sv));
+    expect(parser.help().find("commands:\n  build         build a target\n  clean") != std::string::npos);
+    expect(parser.command()->help().starts_with("usage:\n  program build [-h]"));
+  };
+
+  "clap commands unmatched"_test = [] {
+    const char* argv[] = {"program.exe", "--", "build", "test"};
+    sh::clap parser("program");
+    parser.add_command("build", [](sh::clap&) {});
+    parser.parse(std::size(argv), argv);
+    expect(parser.command() == nullptr);
+    expect(eq(parser.unmatched[0], "build"sv));
+  };
+
+  "clap accumulate"_test = [] {
+    const char* argv[] = {"program.exe", "-I", "a", "-I=b", "--define", "x", "-I", "c"};
+    sh::vector<std::string_view> defines;
+    auto events = 0;
+    sh::clap parser("program");
+    parser.add<sh::vector<std::string_view, 4>>("-I") << [&](std::string_view) { events++; };
+    parser.add<sh::vector<std::string_view>>("--define") << &defines;
+    parser.add<sh::vector<int>>("--empty");
+    parser.add<sh::vector<int>>("--fallback") << 5;
+    parser.parse(std::size(argv), argv);
+
+    const auto includes = parser.get<sh::vector<std::string_view, 4>>("-I");
+    expect(eq(includes.size(), 3));
+    expect(eq(includes[0], "a"sv));
+    expect(eq(includes[2], "c"sv));
+    expect(eq(events, 3));
+    expect(eq(defines.size(), 1));
+    expect(eq(defines[0], "x"sv));
+    expect(eq(parser.get<sh::vector<int>>("--fallback")[0], 5));
+    expect(parser.get<sh::vector<int>>("--empty").empty());
+  };
+
+  "clap accumulate many"_test = [] {
+    std::vector<const char*> argv = {"program.exe"};
+    for (int i = 0; i < 5000; ++i) {
+      argv.push_back("-I");
+      argv.push_back(i % 2 ? "odd" : "even");
+    }
+    sh::clap parser("program");
+    parser.add<sh::vector<std::string_view, 4>>("-I");
+
+    const auto before = allocations.load();
+    parser.parse(argv.size(), argv.data());
+    expect(eq(allocations.load() - before, 1));
+    const auto includes = parser.get<sh::vector<std::string_view, 4>>("-I");
+    expect(eq(includes.size(), 5000));
+    expect(eq(includes[4999], "odd"sv));
+  };
+
+  "clap counter"_test = [] {
+    const char* argv[] = {"program.exe", "-vvv", "-v", "-q", "-x=2", "-ww"};
+    sh::clap parser("program");
+    parser.add<sh::counter>("-v");
+    parser.add<sh::counter>("-q");
+    parser.add<sh::counter>("-x");
+    parser.add<sh::counter>("-y");
+    parser.add<bool>("-w") << false;
+    parser.parse(std::size(argv), argv);
+    expect(eq(std::size_t(parser.get<sh::counter>("-v")), 4));
+    expect(eq(std::size_t(parser.get<sh::counter>("-q")), 1));
+    expect(eq(std::size_t(parser.get<sh::counter>("-x")), 2));
+    expect(eq(std::size_t(parser.get<sh::counter>("-y")), 0));
+    expect(eq(parser.unmatched[0], "-ww"sv));
+  };
+
+  "clap config"_test = [] {
+    sh::config config;
+    config.parse(
+      "threads = 4\n"
+      "output = config.txt\n"
+      "verbose = true\n"
+      "include = a\n"
+      "include = b\n"
+      "[build]\n"
+      "jobs = 8\n");
+
+    const char* argv[] = {"program.exe", "--output", "cli.txt", "build"};
+    sh::clap parser("program");
+    parser.add<int>("-t", "--threads");
+    parser.add<std::string_view>("-o", "--output");
+    parser.add<bool>("--verbose") << false;
+    parser.add<sh::vector<std::string_view>>("-I", "--include");
+    parser.add<int>("--missing") << 1;
+    parser.add_command("build", [](sh::clap& command) {
+      command.add<int>("-j", "--jobs");
+    });
+    parser.parse(std::size(argv), argv, config);
+
+    expect(eq(parser.get<int>("--threads"), 4));
+    expect(eq(parser.get<std::string_view>("--output"), "cli.txt"sv));
+    expect(eq(parser.get<bool>("--verbose"), true));
+    expect(eq(parser.get<sh::vector<std::string_view>>("-I").size(), 2));
+    expect(eq(parser.get<int>("--missing"), 1));
+    expect(eq(parser.command()->get<int>("--jobs"), 8));
+
+    config.parse("threads = x\n");
+    sh::clap invalid("program");
+    invalid.add<int>("--threads");
+    expect(throws([&] { invalid.parse(1, argv, config); }));
+
+    {
+      std::ofstream stream("fs/clap.ini", std::ios::binary);
+      stream << "offset = -0x10\n";
+    }
+    expect(config.open("fs/clap.ini") == sh::filesystem::status::ok);
+    sh::clap mapped("program");
+    mapped.add<int>("--offset");
+    mapped.parse(1, argv, config);
+    expect(eq(mapped.get<int>("--offset"), -16));
+  };
+
+  "clap config lifetime"_test = [] {
+    const char* argv[] = {"program.exe"};
+    sh::clap parser("program");
+    parser.add<std::string_view>("--name");
+    parser.add<int>("--count") << sh::lazy;
+    {
+      std::string text = "name = first\ncount = 3\n";
+      sh::config config;
+      config.parse(text);
+      parser.parse(std::size(argv), argv, config);
+      std::fill(text.begin(), text.end(), 'x');
+    }
+    expect(eq(parser.get<std::string_view>("--name"), "first"sv));
+    expect(eq(parser.get<int>("--count"), 3));
+  };
 };
 
 }  // namespace tests_clap
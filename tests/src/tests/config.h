@@ -0,0 +1,68 @@
+#pragma once
+
+#include <fstream>
+#include <sh/config.h>
+
+#include "allocations.h"
+#include "ut.h"
+
+namespace tests_config {
+
+namespace fs = sh::filesystem;
+
+using namespace std::string_view_literals;
+
+inline suite _ = [] {
+  "config"_test = [] {
+    sh::config config;
+    config.parse(
+      "; comment\n"
+      "name = global\r\n"
+      "\n"
+      "[ server ]\n"
+      "# comment\n"
+      "host=localhost\n"
+      "path = \" spaced \"\n"
+      "port = 80\n"
+      "port = 8080\n"
+      "empty =\n");
+
+    expect(eq(config.size(), 6));
+    expect(eq(*config.get("", "name"), "global"sv));
+    expect(eq(*config.get("server", "host"), "localhost"sv));
+    expect(eq(*config.get("server", "path"), " spaced "sv));
+    expect(eq(*config.get("server", "port"), "8080"sv));
+    expect(eq(config.find("server", "port").size(), 2));
+    expect(eq(config.find("server", "port")[0].value, "80"sv));
+    expect(eq(*config.get("server", "empty"), ""sv));
+    expect(!config.get("", "host"));
+    expect(!config.get("client", "port"));
+
+    expect(throws([&] { config.parse("a = 1\n[section\n"); }));
+    expect(eq(config.size(), 0));
+    expect(throws([&] { config.parse("key\n"); }));
+    expect(throws([&] { config.parse("= value\n"); }));
+  };
+
+  "config file"_test = [] {
+    std::string data;
+    for (std::size_t i = 0; i < 10'000; ++i) {
+      data += fmt::format("key{} = {}\n", i, i);
+    }
+    {
+      std::ofstream stream("fs/config.ini", std::ios::binary);
+      stream << data;
+    }
+
+    sh::config config;
+    const auto before = allocations.load();
+    expect(config.open("fs/config.ini") == fs::status::ok);
+    expect(allocations.load() - before <= 4);
+    expect(eq(config.size(), 10'000));
+    expect(eq(*config.get("", "key9999"), "9999"sv));
+    expect(config.open("fs/missing.ini") != fs::status::ok);
+    expect(eq(*config.get("", "key0"), "0"sv));
+  };
+};
+
+}  // namespace tests_config
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <fstream>
+#include <sh/csv.h>
+
+#include "ut.h"
+
+namespace tests_csv {
+
+namespace fs = sh::filesystem;
+
+inline auto fields(const sh::csv::reader& reader) -> std::vector<std::vector<std::string_view>> {
+  std::vector<std::vector<std::string_view>> rows;
+  for (const auto& row : reader) {
+    auto& fields = rows.emplace_back();
+    for (std::size_t i = 0; i < row.size(); ++i) {
+      fields.push_back(row[i]);
+    }
+  }
+  return rows;
+}
+
+inline suite _ = [] {
+  "csv"_test = [] {
+    using rows = std::vector<std::vector<std::string_view>>;
+
+    sh::csv::reader reader;
+    reader.parse("a,b,c\n1,,3\r\n\"x,y\",\"multi\nline\",\"q\"\"q\"");
+    expect(fields(reader) == rows{{"a", "b", "c"}, {"1", "", "3"}, {"x,y", "multi\nline", "q\"\"q"}});
+    expect(eq(sh::csv::unescape(reader[2].raw(2)), std::string("q\"q")));
+    expect(throws([&] { static_cast<void>(reader[0][3]); }));
+
+    reader.parse("a\tb\n", '\t');
+    expect(fields(reader) == rows{{"a", "b"}});
+
+    reader.parse("");
+    expect(reader.empty());
+  };
+
+  "csv typed"_test = [] {
+    sh::csv::reader reader;
+    reader.parse("id,value\n1,0.5\n2,1.5\n3,x\n");
+    expect(eq(*reader[1].get<int>(0), 1));
+    expect(eq(*reader[2].get<double>(1), 1.5));
+    expect(!reader[3].get<double>(1));
+    expect(!reader[3].get<int>(2));
+    expect(reader.column<int>(0, 1) == std::vector<int>{1, 2, 3});
+    expect(throws([&] { static_cast<void>(reader.column<double>(1, 1)); }));
+  };
+
+  "csv parallel"_test = [] {
+    std::string data;
+    for (std::size_t i = 0; i < 2000; ++i) {
+      if (i % 7 == 0) {
+        data += fmt::format("{},\"quoted, \"\"{}\"\"\nfield\",{}\n", i, i, i * 2);
+      } else {
+        data += fmt::format("{},plain {},{}\n", i, i, i * 2);
+      }
+    }
+
+    sh::csv::reader serial;
+    serial.parse(data);
+    expect(eq(serial.size(), 2000));
+
+    for (std::size_t threads : {2, 3, 8, 64}) {
+      sh::csv::reader parallel;
+      parallel.parse(data, ',', threads);
+      expect(fields(parallel) == fields(serial));
+    }
+    expect(eq(serial[14][1], std::string_view("quoted, \"\"14\"\"\nfield")));
+    expect(serial.column<std::size_t>(2) == [] {
+      std::vector<std::size_t> values;
+      for (std::size_t i = 0; i < 2000; ++i) {
+        values.push_back(i * 2);
+      }
+      return values;
+    }());
+  };
+
+  "csv file"_test = [] {
+    {
+      std::ofstream stream("fs/csv.csv", std::ios::binary);
+      stream << "name,size\nfoo,1\nbar,-0x10\n";
+    }
+
+    sh::csv::reader reader;
+    expect(reader.open("fs/csv.csv") == fs::status::ok);
+    expect(eq(reader.size(), 3));
+    expect(eq(reader[2][0], std::string_view("bar")));
+    expect(eq(*reader[2].get<int>(1), -16));
+    expect(reader.open("fs/missing.csv") != fs::status::ok);
+    expect(reader.empty());
+  };
+};
+
+}  // namespace tests_csv
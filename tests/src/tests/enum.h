@@ -0,0 +1,74 @@
+#pragma once
+
+#include <sh/clap.h>
+#include <sh/enum.h>
+
+#include "ut.h"
+
+namespace tests_enum {
+
+enum class color { red, green, blue };
+enum class level { low = 1, high = 4 };
+
+}  // namespace tests_enum
+
+template<>
+struct sh::enum_names<tests_enum::color> {
+  static constexpr std::pair<std::string_view, tests_enum::color> names[] = {
+    {"red",   tests_enum::color::red},
+    {"green", tests_enum::color::green},
+    {"blue",  tests_enum::color::blue}
+  };
+};
+
+template<>
+struct sh::enum_names<tests_enum::level> {
+  static constexpr std::pair<std::string_view, tests_enum::level> names[] = {
+    {"low",  tests_enum::level::low},
+    {"high", tests_enum::level::high}
+  };
+};
+
+namespace tests_enum {
+
+static_assert(sh::named_enum<color>);
+static_assert(!sh::named_enum<int>);
+static_assert(sh::parser<color>{}.parse("green") == color::green);
+
+inline suite _ = [] {
+  "enum parse"_test = [] {
+    expect(*sh::parse<color>("red") == color::red);
+    expect(*sh::parse<color>("green") == color::green);
+    expect(*sh::parse<color>("blue") == color::blue);
+    expect(*sh::parse<level>("low") == level::low);
+    expect(*sh::parse<level>("high") == level::high);
+    expect(!sh::parse<color>("").has_value());
+    expect(!sh::parse<color>("Red").has_value());
+    expect(!sh::parse<color>("reds").has_value());
+  };
+
+  "enum format"_test = [] {
+    expect(eq(fmt::format("{}", color::blue), std::string("blue")));
+    expect(eq(fmt::format("{}", level::high), std::string("high")));
+    expect(eq(fmt::format("{}", static_cast<level>(2)), std::string("2")));
+  };
+
+  "enum choices"_test = [] {
+    expect(eq(sh::enum_choices<color>(), std::string_view("red|green|blue")));
+    expect(eq(sh::enum_choices<level>(), std::string_view("low|high")));
+  };
+
+  "enum clap"_test = [] {
+    const char* argv[] = {"program.exe", "-c", "green"};
+    sh::clap parser("program");
+    parser.add<color>("-c");
+    parser.add<level>("-l") << level::high;
+    parser.parse(std::size(argv), argv);
+    expect(parser.get<color>("-c") == color::green);
+    expect(parser.get<level>("-l") == level::high);
+    expect(parser.help().find("-c <red|green|blue>") != std::string::npos);
+    expect(parser.help().find("[default: high]") != std::string::npos);
+  };
+};
+
+}  // namespace tests_enum
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <set>
+
 #include <sh/filesystem.h>
+#include <sh/vector.h>
 
 #include "ut.h"
 
@@ -29,6 +32,384 @@ inline suite _ = [] {
     expect(eq(fs::write("fs/data.bin", src), fs::status::ok));
     expect(eq(fs::read("fs/data.bin", dst), fs::status::bad_size));
   };
+
+  "filesystem read reuse"_test = [] {
+    expect(eq(fs::write("fs/long.txt", std::string(1000, 'a')), fs::status::ok));
+    expect(eq(fs::write("fs/short.txt", std::string("bc")), fs::status::ok));
+
+    sh::vector<char> dst;
+    expect(eq(fs::read("fs/long.txt", dst), fs::status::ok));
+    expect(eq(dst.size(), 1000));
+    const auto capacity = dst.capacity();
+    expect(eq(fs::read("fs/short.txt", dst), fs::status::ok));
+    expect(eq(std::string_view(dst.data(), dst.size()), std::string_view("bc")));
+    expect(eq(dst.capacity(), capacity));
+
+    const auto [status, data] = fs::read<std::string>("fs/short.txt");
+    expect(eq(status, fs::status::ok));
+    expect(eq(data, std::string("bc")));
+    expect(eq(fs::read("fs/missing.txt", dst), fs::status::bad_file));
+  };
+
+  "filesystem mapped_file"_test = [] {
+    std::string src = "mapped";
+    expect(eq(fs::write("fs/mapped.txt", src), fs::status::ok));
+
+    fs::mapped_file file;
+    expect(eq(file.open("fs/mapped.txt", fs::mapped_file::access::copy_on_write), fs::status::ok));
+    expect(eq(file.view(), std::string_view(src)));
+    file.data()[0] = 'M';
+
+    fs::mapped_file other;
+    expect(eq(other.open("fs/mapped.txt"), fs::status::ok));
+    expect(eq(other.view(), std::string_view(src)));
+    expect(eq(other.open("fs/missing.txt"), fs::status::bad_file));
+    expect(other.empty());
+  };
+
+  "filesystem mapped_file read/write"_test = [] {
+    std::string src = "abcd";
+    std::string dst;
+    expect(eq(fs::write("fs/mapped.bin", src), fs::status::ok));
+
+    fs::mapped_file file;
+    expect(eq(file.open("fs/mapped.bin", fs::mapped_file::access::read_write, true), fs::status::ok));
+    expect(eq(file.advise(fs::mapped_file::advice::sequential), fs::status::ok));
+    expect(eq(file.bytes().size(), 4));
+    file.bytes()[0] = 'x';
+    expect(eq(file.sync(), fs::status::ok));
+    file.close();
+
+    expect(eq(fs::read("fs/mapped.bin", dst), fs::status::ok));
+    expect(eq(dst, std::string("xbcd")));
+  };
+
+  "filesystem read_many"_test = [] {
+    std::vector<fs::path> files;
+    for (int i = 0; i < 200; ++i) {
+      files.push_back(fmt::format("fs/many/{}.txt", i));
+      expect(eq(fs::write(files.back(), std::string(i * 37, char('a' + i % 26))), fs::status::ok));
+    }
+    files.push_back("fs/many/missing.txt");
+
+    std::size_t ok = 0;
+    std::size_t bad = 0;
+    fs::read_many(files, [&](const fs::path& file, fs::status status, std::span<const sh::u8> data) {
+      if (status != fs::status::ok) {
+        expect(eq(file, files.back()));
+        bad++;
+        return;
+      }
+      const auto index = std::stoi(file.stem().string());
+      expect(eq(data.size(), std::size_t(index * 37)));
+      expect(std::all_of(data.begin(), data.end(), [&](sh::u8 c) { return c == 'a' + index % 26; }));
+      ok++;
+    }, 16);
+    expect(eq(ok, 200));
+    expect(eq(bad, 1));
+
+    std::size_t calls = 0;
+    expect(throws([&] {
+      fs::read_many(files, [&](const fs::path&, fs::status, std::span<const sh::u8>) {
+        if (++calls == 3) {
+          throw sh::error("stop");
+        }
+      }, 16);
+    }));
+    expect(eq(calls, 3));
+  };
+
+  "filesystem writer"_test = [] {
+    std::string dst;
+    for (const auto durability : {fs::writer::durability::none, fs::writer::durability::sync, fs::writer::durability::atomic}) {
+      fs::writer writer;
+      expect(eq(writer.open("fs/writer/data.txt", durability, 1 << 20), fs::status::ok));
+      expect(eq(writer.write(std::string("head "), std::string_view("body "), std::array<char, 4>{'t', 'a', 'i', 'l'}), fs::status::ok));
+      expect(eq(writer.write(std::string_view("!")), fs::status::ok));
+      expect(eq(writer.close(), fs::status::ok));
+      expect(!writer.is_open());
+
+      expect(eq(fs::read("fs/writer/data.txt", dst), fs::status::ok));
+      expect(eq(dst, std::string("head body tail!")));
+    }
+  };
+
+  "filesystem writer atomic discard"_test = [] {
+    std::string dst;
+    expect(eq(fs::write("fs/writer/keep.txt", std::string("old")), fs::status::ok));
+    {
+      fs::writer writer;
+      expect(eq(writer.open("fs/writer/keep.txt", fs::writer::durability::atomic, 0, false), fs::status::ok));
+      expect(eq(writer.write(std::string("new")), fs::status::ok));
+    }
+    expect(eq(fs::read("fs/writer/keep.txt", dst), fs::status::ok));
+    expect(eq(dst, std::string("old")));
+    expect(eq(std::distance(fs::directory_iterator("fs/writer"), fs::directory_iterator()), 2));
+  };
+
+  "filesystem chunk_reader"_test = [] {
+    std::string src;
+    for (int i = 0; i < 10000; ++i) {
+      src.push_back(char('a' + i % 26));
+    }
+    expect(eq(fs::write("fs/chunks.txt", src), fs::status::ok));
+
+    std::string dst;
+    std::size_t chunks = 0;
+    fs::chunk_reader reader;
+    expect(eq(reader.open("fs/chunks.txt", 1024, 2), fs::status::ok));
+    for (const auto& chunk : reader) {
+      expect(chunk.size() <= 1024);
+      dst.append(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+      chunks++;
+    }
+    expect(eq(reader.status(), fs::status::ok));
+    expect(eq(chunks, 10));
+    expect(eq(dst, src));
+
+    expect(eq(reader.open("fs/chunks.txt", 4096), fs::status::ok));
+    const auto first = reader.acquire();
+    const auto second = reader.acquire();
+    expect(first && second);
+    expect(eq(second->data()[0], sh::u8(src[4096])));
+    reader.release();
+    reader.release();
+    expect(eq(reader.acquire()->size(), 10000 - 8192));
+    reader.release();
+    expect(!reader.acquire());
+    expect(eq(reader.open("fs/missing.txt"), fs::status::bad_file));
+    expect(eq(reader.status(), fs::status::bad_file));
+    expect(!reader.acquire());
+    for ([[maybe_unused]] const auto& chunk : reader) {
+      expect(false);
+    }
+
+    expect(eq(reader.open("fs/chunks.txt", 1024, 2), fs::status::ok));
+    reader.close();
+    expect(!reader.acquire());
+    expect(!fs::chunk_reader().acquire());
+  };
+
+  "filesystem file_cache"_test = [] {
+    expect(eq(fs::write("fs/cache/a.txt", std::string("first")), fs::status::ok));
+
+    fs::file_cache cache;
+    const auto [status1, data1] = cache.read("fs/cache/a.txt");
+    const auto [status2, data2] = cache.read("fs/cache/a.txt");
+    expect(eq(status1, fs::status::ok));
+    expect(eq(status2, fs::status::ok));
+    expect(data1 == data2);
+    expect(eq(data1->size(), 5));
+
+    expect(eq(fs::write("fs/cache/a.txt", std::string("second")), fs::status::ok));
+    auto data3 = data1;
+    for (int i = 0; i < 1000 && data3 == data1; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      data3 = std::get<1>(cache.read("fs/cache/a.txt"));
+    }
+    expect(eq(data3->size(), 6));
+    expect(eq(data1->size(), 5));
+
+    const auto [status4, data4] = cache.read("fs/cache/missing.txt");
+    expect(eq(status4, fs::status::bad_file));
+    expect(data4 == nullptr);
+  };
+
+  "filesystem file_cache budget"_test = [] {
+    for (const auto name : {"b", "c", "d"}) {
+      expect(eq(fs::write(fmt::format("fs/cache/{}.txt", name), std::string(40, 'x')), fs::status::ok));
+    }
+
+    fs::file_cache cache(100);
+    static_cast<void>(cache.read("fs/cache/b.txt"));
+    static_cast<void>(cache.read("fs/cache/c.txt"));
+    static_cast<void>(cache.read("fs/cache/b.txt"));
+    static_cast<void>(cache.read("fs/cache/d.txt"));
+    expect(eq(cache.size(), 2));
+    expect(eq(cache.memory(), 80));
+
+    cache.invalidate("fs/cache/b.txt");
+    expect(eq(cache.size(), 1));
+    cache.clear();
+    expect(eq(cache.memory(), 0));
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < 4; ++i) {
+      threads.emplace_back([&cache, i] {
+        for (std::size_t j = 0; j < 100; ++j) {
+          const auto [status, data] = cache.read(fmt::format("fs/cache/{}.txt", "bcd"[(i + j) % 3]));
+          expect(eq(status, fs::status::ok));
+          expect(eq(data->size(), 40));
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    expect(eq(cache.memory(), 40 * cache.size()));
+    expect(cache.memory() <= 100);
+  };
+
+  "filesystem absolute"_test = [] {
+    expect(&fs::program() == &fs::program());
+    expect(eq(fs::program_directory(), fs::program().parent_path()));
+    expect(eq(fs::absolute("data/file.txt"), fs::program_directory() / "data/file.txt"));
+
+    const fs::path paths[] = {"a.txt", fs::program()};
+    const auto absolute = fs::absolute(paths);
+    expect(eq(absolute.size(), 2));
+    expect(eq(absolute[0], fs::program_directory() / "a.txt"));
+    expect(eq(absolute[1], fs::program()));
+
+    fs::path_cache cache;
+    const auto& path = cache("res/icon.png");
+    expect(&path == &cache("res/icon.png"));
+    expect(eq(path, fs::program_directory() / "res/icon.png"));
+    expect(eq(cache.size(), 1));
+  };
+
+  "filesystem copy_file_fast"_test = [] {
+    std::string src(3 << 20, 'x');
+    std::string dst;
+    src[12345] = 'y';
+    expect(eq(fs::write("fs/copy/src.bin", src), fs::status::ok));
+
+    sh::u64 reported = 0;
+    const auto [status, copied] = fs::copy_file_fast("fs/copy/src.bin", "fs/copy/dst.bin", [&](sh::u64 copied, sh::u64 total) {
+      expect(eq(total, src.size()));
+      reported = copied;
+    });
+    expect(eq(status, fs::status::ok));
+    expect(eq(copied, src.size()));
+    expect(eq(reported, src.size()));
+    expect(eq(fs::read("fs/copy/dst.bin", dst), fs::status::ok));
+    expect(dst == src);
+
+    expect(eq(fs::move_file_fast("fs/copy/dst.bin", "fs/copy/moved.bin"), fs::status::ok));
+    expect(!fs::exists("fs/copy/dst.bin"));
+    expect(eq(fs::read("fs/copy/moved.bin", dst), fs::status::ok));
+    expect(dst == src);
+    expect(eq(std::get<0>(fs::copy_file_fast("fs/copy/missing.bin", "fs/copy/x.bin")), fs::status::bad_file));
+
+    expect(eq(std::get<0>(fs::copy_file_fast("fs/copy/moved.bin", "fs/copy/moved.bin")), fs::status::bad_file));
+    expect(eq(fs::file_size("fs/copy/moved.bin"), src.size()));
+
+    expect(eq(fs::write("fs/copy/small.bin", std::string("small")), fs::status::ok));
+    expect(eq(std::get<0>(fs::copy_file_fast("fs/copy/small.bin", "fs/copy/moved.bin")), fs::status::ok));
+    expect(eq(fs::read("fs/copy/moved.bin", dst), fs::status::ok));
+    expect(eq(dst, std::string("small")));
+  };
+
+  "filesystem glob"_test = [] {
+    expect(fs::glob("*.cpp", "main.cpp"));
+    expect(!fs::glob("*.cpp", "main.h"));
+    expect(fs::glob("*.h;*.cpp", "main.h"));
+    expect(fs::glob("te?t[0-9].*", "test1.txt"));
+    expect(!fs::glob("test[!0-9]", "test1"));
+    expect(fs::glob("*a*b*", "xxaxxbxx"));
+    expect(fs::glob("", ""));
+    expect(!fs::glob("", "a"));
+
+    expect(fs::glob("x[;a]y", "x;y"));
+    expect(fs::glob("x[;a]y", "xay"));
+    expect(!fs::glob("x[;a]y", "x"));
+    expect(fs::glob("*.h;x[;a]y;*.cpp", "x;y"));
+    expect(fs::glob("*.h;x[;a]y;*.cpp", "main.cpp"));
+    expect(fs::glob("a[!]]", "ab"));
+    expect(!fs::glob("a[!]]", "a]"));
+    expect(fs::glob("a[]]", "a]"));
+    expect(fs::glob("a[!]", "a[!]"));
+    expect(!fs::glob("a[!]", "ab"));
+  };
+
+  "filesystem scan"_test = [] {
+    std::error_code ec;
+    fs::remove_all("fs/scan", ec);
+    std::set<std::string> expected;
+    for (int i = 0; i < 20; ++i) {
+      for (int j = 0; j < 30; ++j) {
+        const auto file = fmt::format("fs/scan/{}/{}/file{}.{}", i % 4, i, j, j % 2 ? "cpp" : "h");
+        expect(eq(fs::write(file, std::string("x")), fs::status::ok));
+        if (j % 2) {
+          expected.insert(fs::path(file).string());
+        }
+      }
+    }
+
+    for (const auto threads : {1, 4}) {
+      std::set<std::string> found;
+      std::size_t batches = 0;
+      fs::scan("fs/scan", "*.cpp", [&](std::span<const fs::scan_entry> entries) {
+        batches++;
+        for (const auto& entry : entries) {
+          expect(entry.type == fs::file_type::regular);
+          found.insert(entry.file.string());
+        }
+      }, threads);
+      expect(found == expected);
+      expect(batches < expected.size());
+    }
+
+    for (const auto threads : {1, 4}) {
+      expect(throws([&] {
+        fs::scan("fs/scan", {}, [](std::span<const fs::scan_entry>) {
+          throw sh::error("stop");
+        }, threads);
+      }));
+    }
+  };
+
+  "filesystem snapshot"_test = [] {
+    std::error_code ec;
+    fs::remove_all("fs/snapshot", ec);
+    expect(eq(fs::write("fs/snapshot/a.txt", std::string("a")), fs::status::ok));
+    expect(eq(fs::write("fs/snapshot/b.txt", std::string("b")), fs::status::ok));
+    expect(eq(fs::write("fs/snapshot/sub/c.txt", std::string("c")), fs::status::ok));
+
+    const auto first = fs::snapshot::capture("fs/snapshot");
+    expect(eq(first.size(), 3));
+    expect(first.find("sub/c.txt") != nullptr);
+    expect(eq(first.save("fs/snapshot.bin"), fs::status::ok));
+
+    fs::snapshot loaded;
+    expect(eq(loaded.load("fs/snapshot.bin"), fs::status::ok));
+    expect(eq(loaded.size(), 3));
+    expect(eq(loaded.find("a.txt")->hash, first.find("a.txt")->hash));
+    expect(eq(loaded.find("sub/c.txt")->size, 1));
+
+    const auto same = fs::diff(loaded, fs::snapshot::capture("fs/snapshot", {}, loaded));
+    expect(same.added.empty() && same.removed.empty() && same.modified.empty());
+
+    expect(eq(fs::write("fs/snapshot/a.txt", std::string("changed")), fs::status::ok));
+    expect(eq(fs::write("fs/snapshot/d.txt", std::string("d")), fs::status::ok));
+    fs::remove("fs/snapshot/b.txt");
+
+    const auto diff = fs::diff(loaded, fs::snapshot::capture("fs/snapshot", {}, loaded));
+    expect(diff.added == std::vector<std::string>{"d.txt"});
+    expect(diff.removed == std::vector<std::string>{"b.txt"});
+    expect(diff.modified == std::vector<std::string>{"a.txt"});
+
+    expect(eq(fs::write("fs/snapshot.bin", std::string("junk")), fs::status::ok));
+    expect(eq(loaded.load("fs/snapshot.bin"), fs::status::bad_size));
+
+    const auto crafted = [](sh::u64 entries, sh::u64 names, std::span<const sh::u64> body) {
+      const sh::u32 head[] = {0x5353'4853, 1};
+      const sh::u64 sizes[] = {entries, names};
+      std::string data;
+      data.append(reinterpret_cast<const char*>(head), sizeof(head));
+      data.append(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+      data.append(reinterpret_cast<const char*>(body.data()), body.size_bytes());
+      data.append(names, 'x');
+      return data;
+    };
+
+    expect(eq(fs::write("fs/snapshot.bin", crafted(sh::u64(1) << 60, 0, {})), fs::status::ok));
+    expect(eq(loaded.load("fs/snapshot.bin"), fs::status::bad_size));
+
+    const sh::u64 entry[] = {1, 0, 0, 0, 100, 1};
+    expect(eq(fs::write("fs/snapshot.bin", crafted(1, 1, entry)), fs::status::ok));
+    expect(eq(loaded.load("fs/snapshot.bin"), fs::status::bad_size));
+  };
 };
 
 }  // namespace tests_filesystem
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <sh/fmt.h>
+
+#include "ut.h"
+
+namespace tests_fmt {
+
+template<std::size_t kSize>
+auto view(const sh::vector<char, kSize>& buffer) -> std::string_view {
+  return {buffer.data(), buffer.size()};
+}
+
+inline suite _ = [] {
+  "format_to inline"_test = [] {
+    sh::vector<char, 32> buffer;
+    sh::format_to(buffer, "{}-{}", 1, "ab");
+    expect(eq(view(buffer), std::string_view("1-ab")));
+    expect(eq(buffer.capacity(), 32));
+  };
+
+  "format_to grow"_test = [] {
+    sh::vector<char, 4> buffer;
+    sh::format_to(buffer, "{}", "abc");
+    sh::format_to(buffer, " {:>8}", 42);
+    expect(eq(view(buffer), std::string_view("abc       42")));
+  };
+
+  "format_to heap"_test = [] {
+    sh::vector<char> buffer;
+    sh::format_to(buffer, "{}", 1);
+    sh::format_to(buffer, "{}", 2);
+    expect(eq(view(buffer), std::string_view("12")));
+  };
+
+  "format_to append"_test = [] {
+    sh::vector<char, 16> buffer;
+    std::size_t reallocations = 0;
+    for (int i = 0; i < 10000; ++i) {
+      const auto capacity = buffer.capacity();
+      sh::format_to(buffer, "{:04} ", i % 10000);
+      reallocations += buffer.capacity() != capacity;
+    }
+    expect(eq(buffer.size(), 50000));
+    expect(view(buffer).starts_with("0000 0001 "));
+    expect(view(buffer).ends_with("9998 9999 "));
+    expect(reallocations <= 20);
+    expect(buffer.capacity() < 2 * buffer.size());
+  };
+};
+
+}  // namespace tests_fmt
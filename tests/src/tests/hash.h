@@ -15,6 +15,16 @@ inline suite _ = [] {
     int data[] = {0x1234'5678, 0x1234'5678, 0x1234'5678, 0x1234'5678};
     expect(eq(sh::hash(std::begin(data), std::end(data)), 0xAFFC'E2EE'423B'D28D));
   };
+
+  "perfect hash"_test = [] {
+    constexpr sh::perfect_hash<4> hash({"-a", "-b", "--alpha", "--beta"});
+    static_assert(hash.find("-a") == 0);
+    static_assert(hash.find("--beta") == 3);
+    expect(eq(hash.find("-b"), 1));
+    expect(eq(hash.find("--alpha"), 2));
+    expect(eq(hash.find("-c"), hash.npos));
+    expect(eq(hash.find(""), hash.npos));
+  };
 };
 
 }  // namespace tests_hash
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <sh/lines.h>
+#include <sh/parse.h>
+#include <sh/ranges.h>
+
+#include "ut.h"
+
+namespace tests_lines {
+
+static_assert(sh::forward_range<sh::lines>);
+static_assert(std::ranges::forward_range<sh::lines>);
+
+inline auto collect(const sh::lines& lines) -> std::vector<std::string_view> {
+  return {lines.begin(), lines.end()};
+}
+
+inline suite _ = [] {
+  "lines"_test = [] {
+    using lines = std::vector<std::string_view>;
+    expect(collect(sh::lines("")).empty());
+    expect(collect(sh::lines("a")) == lines{"a"});
+    expect(collect(sh::lines("a\n")) == lines{"a"});
+    expect(collect(sh::lines("\n")) == lines{""});
+    expect(collect(sh::lines("a\r\nb\n\nc")) == lines{"a", "b", "", "c"});
+    expect(collect(sh::lines("a\rb\r")) == lines{"a\rb\r"});
+  };
+
+  "lines simd"_test = [] {
+    std::string data;
+    std::vector<std::string> expected;
+    for (std::size_t i = 0; i < 200; ++i) {
+      auto& line = expected.emplace_back(i % 37, static_cast<char>('a' + i % 26));
+      data += line;
+      data += i % 3 ? "\n" : "\r\n";
+    }
+
+    const auto lines = collect(sh::lines(data));
+    expect(eq(lines.size(), expected.size()));
+    for (std::size_t i = 0; i < lines.size(); ++i) {
+      expect(eq(lines[i], std::string_view(expected[i])));
+    }
+  };
+
+  "lines split"_test = [] {
+    std::string data;
+    for (std::size_t i = 0; i < 1000; ++i) {
+      data += fmt::format("{}\n", i);
+    }
+
+    const sh::lines lines(data);
+    for (std::size_t count : {1, 3, 7, 64}) {
+      std::size_t size = 0;
+      std::vector<std::string_view> joined;
+      for (const auto& chunk : lines.split(count)) {
+        expect(chunk.data().ends_with('\n'));
+        size += chunk.data().size();
+        for (const auto& line : chunk) {
+          joined.push_back(line);
+        }
+      }
+      expect(eq(size, data.size()));
+      expect(joined == collect(lines));
+    }
+    expect(eq(sh::lines("a\nb").split(4).size(), 2));
+    expect(sh::lines("").split(4).empty());
+  };
+
+  "lines parallel"_test = [] {
+    std::string data;
+    for (std::size_t i = 0; i < 1000; ++i) {
+      data += fmt::format("{}\r\n", i);
+    }
+
+    std::atomic<std::size_t> sum = 0;
+    sh::lines(data).parallel([&](std::size_t, sh::lines chunk) {
+      for (const auto& line : chunk) {
+        sum += *sh::parse<std::size_t>(line);
+      }
+    }, 4);
+    expect(eq(sum.load(), 999 * 1000 / 2));
+
+    expect(throws([&] {
+      sh::lines(data).parallel([](std::size_t index, sh::lines) {
+        if (index == 1) {
+          throw sh::error("chunk");
+        }
+      }, 4);
+    }));
+  };
+};
+
+}  // namespace tests_lines
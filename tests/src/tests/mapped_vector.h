@@ -0,0 +1,74 @@
+#pragma once
+
+#include <sh/mapped_vector.h>
+
+#include "ut.h"
+
+namespace tests_mapped_vector {
+
+namespace fs = sh::filesystem;
+
+struct record {
+  sh::u32 id;
+  double value;
+};
+
+inline suite _ = [] {
+  "mapped_vector persist"_test = [] {
+    std::error_code ec;
+    fs::remove("fs/records.bin", ec);
+    {
+      sh::mapped_vector<record> vec;
+      expect(vec.open("fs/records.bin") == fs::status::ok);
+      expect(vec.empty());
+      for (sh::u32 i = 0; i < 10000; ++i) {
+        vec.emplace_back(i, i * 0.5);
+      }
+      expect(eq(vec.size(), 10000));
+      expect(vec.capacity() >= vec.size());
+      expect(vec.flush() == fs::status::ok);
+    }
+
+    sh::mapped_vector<record> vec;
+    expect(vec.open("fs/records.bin") == fs::status::ok);
+    expect(eq(vec.size(), 10000));
+    expect(eq(vec[1234].id, 1234));
+    expect(eq(vec.back().value, 9999 * 0.5));
+
+    vec.pop_back();
+    vec.shrink_to_fit();
+    expect(eq(vec.capacity(), 9999));
+    expect(eq(fs::file_size("fs/records.bin"), 64 + 9999 * sizeof(record)));
+    vec.resize(5);
+    expect(eq(vec.size(), 5));
+    expect(eq(std::distance(vec.begin(), vec.end()), 5));
+    vec.clear();
+    expect(vec.empty());
+  };
+
+  "mapped_vector grow failure"_test = [] {
+    std::error_code ec;
+    fs::remove("fs/overflow.bin", ec);
+    sh::mapped_vector<record> vec;
+    expect(vec.open("fs/overflow.bin") == fs::status::ok);
+    vec.push_back({7, 0.5});
+    expect(throws([&] { vec.reserve(vec.max_size() + 1); }));
+    expect(throws([&] { vec.reserve(std::numeric_limits<std::size_t>::max()); }));
+    expect(vec.is_open());
+    expect(eq(vec.size(), 1));
+    expect(eq(vec[0].id, 7));
+  };
+
+  "mapped_vector type mismatch"_test = [] {
+    {
+      sh::mapped_vector<sh::u32> vec;
+      expect(vec.open("fs/values.bin") == fs::status::ok);
+      vec.push_back(1);
+    }
+    sh::mapped_vector<sh::u64> vec;
+    expect(vec.open("fs/values.bin") == fs::status::bad_size);
+    expect(!vec.is_open());
+  };
+};
+
+}  // namespace tests_mapped_vector
@@ -5,6 +5,7 @@
 #include <sh/int.h>
 #include <sh/parse.h>
 
+#include "allocations.h"
 #include "ut.h"
 
 namespace tests_parse {
@@ -128,6 +129,39 @@ inline suite _ = [] {
     expect(eq(*sh::parse<bool>("0"), false));
     expect(!sh::parse<bool>(" "));
   };
+
+  "parse<std::vector>"_test = [] {
+    expect(eq(*sh::parse<std::vector<int>>("1,2,3"), std::vector<int>{1, 2, 3}));
+    expect(eq(*sh::parse<std::vector<int>>(" 1 , 2 ,3 "), std::vector<int>{1, 2, 3}));
+    expect(eq(*sh::parse<std::vector<int>>("1;0x2", ';'), std::vector<int>{1, 2}));
+    expect(eq(sh::parse<std::vector<int>>("")->size(), 0));
+    expect(eq(sh::parse<std::vector<int>>("  ")->size(), 0));
+    expect(!sh::parse<std::vector<int>>("1,,3"));
+    expect(!sh::parse<std::vector<int>>("1,x"));
+
+    std::string data = "0";
+    for (int i = 1; i < 1000; ++i) {
+      data += fmt::format(",{}", i);
+    }
+    const auto before = allocations.load();
+    const auto values = sh::parse<std::vector<int>>(data);
+    expect(eq(allocations.load() - before, 1));
+    expect(eq(values->size(), 1000));
+    expect(eq(values->back(), 999));
+  };
+
+  "parse<sh::vector>"_test = [] {
+    const auto value = sh::parse<sh::vector<std::string_view, 4>>("a,b,c");
+    expect(value.has_value());
+    expect(eq(value->size(), 3));
+    expect(eq((*value)[2], std::string_view("c")));
+  };
+
+  "parse<std::array>"_test = [] {
+    expect(*sh::parse<std::array<int, 3>>("1,2,3") == std::array<int, 3>{1, 2, 3});
+    expect(!sh::parse<std::array<int, 3>>("1,2"));
+    expect(!sh::parse<std::array<int, 3>>("1,2,3,4"));
+  };
 };
 
 }  // namespace tests_parse
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <sh/static_clap.h>
+
+#include "ut.h"
+
+namespace tests_static_clap {
+
+using namespace std::string_view_literals;
+
+inline suite _ = [] {
+  "static_clap general"_test = [] {
+    const char* argv[] = {"program.exe", "--threads", "4", "-v", "--name=test", "input", "extra"};
+    sh::static_clap<
+      sh::arg<"--threads", int>,
+      sh::arg<"--level", int, 2>,
+      sh::arg<"-v", bool>,
+      sh::arg<"--name", std::string_view>,
+      sh::arg<"--size", std::optional<int>>,
+      sh::arg<"file", std::string_view>
+    > parser;
+    parser.parse(std::size(argv), argv);
+    expect(eq(parser.get<"--threads">(), 4));
+    expect(eq(parser.get<"--level">(), 2));
+    expect(eq(parser.get<"-v">(), true));
+    expect(eq(parser.get<"--name">(), "test"sv));
+    expect(eq(parser.get<"--size">().has_value(), false));
+    expect(eq(parser.get<"file">(), "input"sv));
+    expect(eq(parser.unmatched[0], "extra"sv));
+  };
+
+  "static_clap accumulate and count"_test = [] {
+    const char* argv[] = {"program.exe", "-I", "a", "-vvv", "-I=b", "-v", "-q=2", "--define", "x"};
+    sh::static_clap<
+      sh::arg<"-I", sh::vector<std::string_view, 4>>,
+      sh::arg<"--define", sh::vector<std::string_view>>,
+      sh::arg<"--empty", sh::vector<int>>,
+      sh::arg<"--fallback", sh::vector<int>, 5>,
+      sh::arg<"-v", sh::counter>,
+      sh::arg<"-q", sh::counter>,
+      sh::arg<"-w", sh::counter>
+    > parser;
+    parser.parse(std::size(argv), argv);
+
+    const auto includes = parser.get<"-I">();
+    expect(eq(includes.size(), 2));
+    expect(eq(includes[0], "a"sv));
+    expect(eq(includes[1], "b"sv));
+    expect(eq(parser.get<"--define">()[0], "x"sv));
+    expect(parser.get<"--empty">().empty());
+    expect(eq(parser.get<"--fallback">()[0], 5));
+    expect(eq(std::size_t(parser.get<"-v">()), 4));
+    expect(eq(std::size_t(parser.get<"-q">()), 2));
+    expect(eq(std::size_t(parser.get<"-w">()), 0));
+  };
+
+  "static_clap missing argument"_test = [] {
+    const char* argv[] = {"program.exe"};
+    sh::static_clap<sh::arg<"-x", int>> parser;
+    expect(throws([&]() {
+      parser.parse(std::size(argv), argv);
+    }));
+  };
+
+  "static_clap wrong argument value type"_test = [] {
+    const char* argv[] = {"program.exe", "-x", "wrong"};
+    sh::static_clap<sh::arg<"-x", int>> parser;
+    expect(throws([&]() {
+      parser.parse(std::size(argv), argv);
+    }));
+  };
+
+  "static_clap force positional"_test = [] {
+    const char* argv[] = {"program.exe", "--", "-x"};
+    sh::static_clap<sh::arg<"-x", int, 0>, sh::arg<"y", std::string_view>> parser;
+    parser.parse(std::size(argv), argv);
+    expect(eq(parser.get<"-x">(), 0));
+    expect(eq(parser.get<"y">(), "-x"sv));
+  };
+};
+
+}  // namespace tests_static_clap
@@ -778,6 +778,22 @@ struct tests_resize : tests<T, N> {
         expect(eq(vec1[1], 0));
       }
     };
+
+    test("resize_for_overwrite(size_type)") = [] {
+      if constexpr (std::default_initializable<T> && sh::copy_assignable<T>) {
+        vector vec1{};
+        vec1.resize_for_overwrite(5);
+        expect(eq(vec1.size(), 5));
+        expect(eq(vec1.capacity(), capacity(5)));
+        std::fill(vec1.begin(), vec1.end(), T(1));
+        expect(eq(vec1, vector{1, 1, 1, 1, 1}));
+
+        vec1.resize_for_overwrite(2);
+        expect(eq(vec1.size(), 2));
+        expect(eq(vec1.capacity(), capacity(5)));
+        expect(eq(vec1, vector{1, 1}));
+      }
+    };
   }
 };
 